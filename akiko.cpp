@@ -328,59 +328,50 @@ static void akiko_c2p_do (void)
 	}
 }
 #else
-/* Optimised Chunky-to-Planar algorithm by Mequa */
-static uae_u32 akiko_precalc_shift[32];
-static uae_u32 akiko_precalc_bytenum[32][8];
-static void akiko_c2p_precalculate(void)
-{
-	uae_u32 i, j;
-	for (i = 0; i < 32; i++) {
-		akiko_precalc_shift[i] = 1 << i;
-		for (j = 0; j < 8; j++) {
-			akiko_precalc_bytenum[i][j] = (i >> 3) + ((7 - j) << 2);
-		}
-	}
-}
-
+/* 8x32 bit matrix transpose, five swap passes over all 8 longs at once
+ * instead of testing each of the 256 bits separately.
+ */
+#define C2P_MERGE(a, b, shift, mask) { uae_u32 t = ((a >> shift) ^ b) & mask; b ^= t; a ^= t << shift; }
 static void akiko_c2p_do(void)
 {
-	int i;
-
-	for (i = 0; i < 8; i++) {
-		akiko_result[i]    =  (((akiko_buffer[0] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][0])   )
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][1])   )
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][2])   )
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][3])   )
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][4])   )
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][5])   )
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][6])   )
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][7])   )
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][0]) )
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][1]) )
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][2]) )
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][3]) )
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][4]) )
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][5]) )
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][6]) )
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][7]) )
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][0]))
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][1]))
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][2]))
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][3]))
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][4]))
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][5]))
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][6]))
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][7]))
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][0]))
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][1]))
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][2]))
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][3]))
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][4]))
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][5]))
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][6]))
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][7]));
-	}
-}
+	uae_u32 a0 = akiko_buffer[7], a1 = akiko_buffer[6], a2 = akiko_buffer[5], a3 = akiko_buffer[4];
+	uae_u32 a4 = akiko_buffer[3], a5 = akiko_buffer[2], a6 = akiko_buffer[1], a7 = akiko_buffer[0];
+
+	C2P_MERGE(a0, a4, 16, 0x0000ffff);
+	C2P_MERGE(a1, a5, 16, 0x0000ffff);
+	C2P_MERGE(a2, a6, 16, 0x0000ffff);
+	C2P_MERGE(a3, a7, 16, 0x0000ffff);
+
+	C2P_MERGE(a0, a2, 8, 0x00ff00ff);
+	C2P_MERGE(a1, a3, 8, 0x00ff00ff);
+	C2P_MERGE(a4, a6, 8, 0x00ff00ff);
+	C2P_MERGE(a5, a7, 8, 0x00ff00ff);
+
+	C2P_MERGE(a0, a1, 4, 0x0f0f0f0f);
+	C2P_MERGE(a2, a3, 4, 0x0f0f0f0f);
+	C2P_MERGE(a4, a5, 4, 0x0f0f0f0f);
+	C2P_MERGE(a6, a7, 4, 0x0f0f0f0f);
+
+	C2P_MERGE(a0, a4, 2, 0x33333333);
+	C2P_MERGE(a1, a5, 2, 0x33333333);
+	C2P_MERGE(a2, a6, 2, 0x33333333);
+	C2P_MERGE(a3, a7, 2, 0x33333333);
+
+	C2P_MERGE(a0, a2, 1, 0x55555555);
+	C2P_MERGE(a1, a3, 1, 0x55555555);
+	C2P_MERGE(a4, a6, 1, 0x55555555);
+	C2P_MERGE(a5, a7, 1, 0x55555555);
+
+	akiko_result[0] = a0;
+	akiko_result[1] = a2;
+	akiko_result[2] = a4;
+	akiko_result[3] = a6;
+	akiko_result[4] = a1;
+	akiko_result[5] = a3;
+	akiko_result[6] = a5;
+	akiko_result[7] = a7;
+}
+#undef C2P_MERGE
 #endif
 
 static void akiko_c2p_write(int offset, uae_u32 v)
@@ -408,6 +399,30 @@ static uae_u32 akiko_c2p_read(int offset)
 	return v >> (8 * (3 - offset));
 }
 
+/* Long accesses to $B80038 are what C2P loops use, skip the per-byte path */
+static void akiko_c2p_write_long(uae_u32 v)
+{
+	akiko_buffer[akiko_write_offset] = v;
+	akiko_write_offset++;
+	akiko_write_offset &= 7;
+	akiko_read_offset = -1;
+}
+
+static uae_u32 akiko_c2p_read_long(void)
+{
+	uae_u32 v;
+
+	if (akiko_read_offset < 0) {
+		akiko_c2p_do();
+		akiko_read_offset = 0;
+	}
+	akiko_write_offset = 0;
+	v = akiko_result[akiko_read_offset];
+	akiko_read_offset++;
+	akiko_read_offset &= 7;
+	return v;
+}
+
 /* CD32 CDROM hardware emulation
 * Akiko addresses used:
 * 0xb80004-0xb80028
@@ -1864,6 +1879,8 @@ static uae_u32 REGPARAM2 akiko_lget (uaecptr addr)
 	addr &= 0xffff;
 	if (addr >= 0x8000)
 		return 0;
+	if (addr == 0x38 && currprefs.cs_cd32c2p)
+		return akiko_c2p_read_long();
 	v = akiko_bget2 (addr + 3, 0);
 	v |= akiko_bget2 (addr + 2, 0) << 8;
 	v |= akiko_bget2 (addr + 1, 0) << 16;
@@ -2041,6 +2058,11 @@ static void REGPARAM2 akiko_lput (uaecptr addr, uae_u32 v)
 		if (log_cd32 > 1)
 			write_log (_T("akiko_lput %08X: %08X=%08X\n"), M68K_GETPC, addr, v);
 	}
+	if (addr == 0x38) {
+		if (currprefs.cs_cd32c2p)
+			akiko_c2p_write_long(v);
+		return;
+	}
 	akiko_bput2 (addr + 3, (v >> 0) & 0xff, 0);
 	akiko_bput2 (addr + 2, (v >> 8) & 0xff, 0);
 	akiko_bput2 (addr + 1, (v >> 16) & 0xff, 0);
@@ -2123,7 +2145,6 @@ static void akiko_reset(int hardreset)
 	cdaudiostop_do();
 	nvram_read();
 	eeprom_reset(cd32_eeprom);
-	akiko_c2p_precalculate();
 
 	cdrom_speed = 1;
 	cdrom_current_sector = -1;
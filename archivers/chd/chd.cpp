@@ -16,6 +16,7 @@
 #include "chdcdrom.h"
 #include "coretmpl.h"
 #include "chdcodec.h"
+#include "uae.h"
 
 #include <zlib.h>
 #include <time.h>
@@ -37,6 +38,12 @@ const char *AV_METADATA_FORMAT = "FPS:%d.%06d WIDTH:%d HEIGHT:%d INTERLACED:%d C
 
 static const UINT32 METADATA_HEADER_SIZE = 16;          // metadata header size
 
+// decoded hunk cache and read-ahead sizing
+static const UINT32 HUNK_CACHE_BYTES = 4 * 1024 * 1024; // total decoded hunk cache size
+static const int HUNK_CACHE_MIN = 8;                    // minimum number of cached hunks
+static const int HUNK_CACHE_MAX = 1024;                 // maximum number of cached hunks
+static const UINT32 READAHEAD_BYTES = 256 * 1024;       // how far ahead to decode on sequential reads
+
 static const UINT8 V34_MAP_ENTRY_FLAG_TYPE_MASK = 0x0f;     // what type of hunk
 static const UINT8 V34_MAP_ENTRY_FLAG_NO_CRC = 0x10;        // no CRC is present
 
@@ -175,9 +182,14 @@ inline void chd_file::file_read(UINT64 offset, void *dest, UINT32 length)
 	if (m_file == NULL)
 		throw CHDERR_NOT_OPEN;
 
-	// seek and read
+	// seek and read; the read-ahead worker shares the file handle
+	bool locked = m_file_lock != NULL;
+	if (locked)
+		uae_sem_wait(&m_file_lock);
 	core_fseek(m_file, offset, SEEK_SET);
 	UINT32 count = core_fread(m_file, dest, length);
+	if (locked)
+		uae_sem_post(&m_file_lock);
 	if (count != length)
 		throw CHDERR_READ_ERROR;
 }
@@ -271,10 +283,21 @@ inline UINT8 chd_file::bits_for_value(UINT64 value)
 
 chd_file::chd_file()
 	: m_file(NULL),
-		m_owns_file(false)
+		m_owns_file(false),
+		m_hcache(NULL),
+		m_hcache_mem(NULL),
+		m_hcache_count(0),
+		m_ra_state(0),
+		m_ra_lock(NULL),
+		m_ra_wake(NULL),
+		m_ra_done(NULL),
+		m_ra_waiting(0),
+		m_file_lock(NULL),
+		m_read_lock(NULL)
 {
 	// reset state
 	memset(m_decompressor, 0, sizeof(m_decompressor));
+	memset(m_ra_decompressor, 0, sizeof(m_ra_decompressor));
 	close();
 }
 
@@ -671,6 +694,10 @@ chd_error chd_file::open(core_file &file, bool writeable, chd_file *parent)
 
 void chd_file::close()
 {
+	// stop the read-ahead worker before the file goes away
+	readahead_stop();
+	hcache_free();
+
 	// reset file characteristics
 	if (m_owns_file && m_file != NULL)
 		core_fclose(m_file);
@@ -722,6 +749,19 @@ void chd_file::close()
 //-------------------------------------------------
 
 chd_error chd_file::read_hunk(UINT32 hunknum, void *buffer)
+{
+	return read_hunk_ctx(hunknum, buffer, m_decompressor, m_compressed, false);
+}
+
+
+//-------------------------------------------------
+//  read_hunk_ctx - read a single hunk using the
+//  given codecs and compressed data buffer; the
+//  read-ahead worker has its own set and leaves
+//  parent hunks to the caller
+//-------------------------------------------------
+
+chd_error chd_file::read_hunk_ctx(UINT32 hunknum, void *buffer, chd_decompressor **decompressor, dynamic_buffer &compressed, bool readahead)
 {
 	// wrap this for clean reporting
 	try
@@ -752,8 +792,8 @@ chd_error chd_file::read_hunk(UINT32 hunknum, void *buffer)
 				{
 					case V34_MAP_ENTRY_TYPE_COMPRESSED:
 						blocklen = be_read(&rawmap[12], 2) + (rawmap[14] << 16);
-						file_read(blockoffs, m_compressed, blocklen);
-						m_decompressor[0]->decompress(m_compressed, blocklen, dest, m_hunkbytes);
+						file_read(blockoffs, compressed, blocklen);
+						decompressor[0]->decompress(compressed, blocklen, dest, m_hunkbytes);
 						if (!(rawmap[15] & V34_MAP_ENTRY_FLAG_NO_CRC) && dest != NULL && crc32_creator::simple(dest, m_hunkbytes) != blockcrc)
 							throw CHDERR_DECOMPRESSION_ERROR;
 						return CHDERR_NONE;
@@ -773,10 +813,10 @@ chd_error chd_file::read_hunk(UINT32 hunknum, void *buffer)
 						return CHDERR_NONE;
 
 					case V34_MAP_ENTRY_TYPE_SELF_HUNK:
-						return read_hunk(blockoffs, dest);
+						return read_hunk_ctx(blockoffs, dest, decompressor, compressed, readahead);
 
 					case V34_MAP_ENTRY_TYPE_PARENT_HUNK:
-						if (m_parent_missing)
+						if (m_parent_missing || readahead)
 							throw CHDERR_REQUIRES_PARENT;
 						return m_parent->read_hunk(blockoffs, dest);
 				}
@@ -811,11 +851,11 @@ chd_error chd_file::read_hunk(UINT32 hunknum, void *buffer)
 					case COMPRESSION_TYPE_1:
 					case COMPRESSION_TYPE_2:
 					case COMPRESSION_TYPE_3:
-						file_read(blockoffs, m_compressed, blocklen);
-						m_decompressor[rawmap[0]]->decompress(m_compressed, blocklen, dest, m_hunkbytes);
-						if (!m_decompressor[rawmap[0]]->lossy() && dest != NULL && crc16_creator::simple(dest, m_hunkbytes) != blockcrc)
+						file_read(blockoffs, compressed, blocklen);
+						decompressor[rawmap[0]]->decompress(compressed, blocklen, dest, m_hunkbytes);
+						if (!decompressor[rawmap[0]]->lossy() && dest != NULL && crc16_creator::simple(dest, m_hunkbytes) != blockcrc)
 							throw CHDERR_DECOMPRESSION_ERROR;
-						if (m_decompressor[rawmap[0]]->lossy() && crc16_creator::simple(m_compressed, blocklen) != blockcrc)
+						if (decompressor[rawmap[0]]->lossy() && crc16_creator::simple(compressed, blocklen) != blockcrc)
 							throw CHDERR_DECOMPRESSION_ERROR;
 						return CHDERR_NONE;
 
@@ -826,10 +866,10 @@ chd_error chd_file::read_hunk(UINT32 hunknum, void *buffer)
 						return CHDERR_NONE;
 
 					case COMPRESSION_SELF:
-						return read_hunk(blockoffs, dest);
+						return read_hunk_ctx(blockoffs, dest, decompressor, compressed, readahead);
 
 					case COMPRESSION_PARENT:
-						if (m_parent_missing)
+						if (m_parent_missing || readahead)
 							throw CHDERR_REQUIRES_PARENT;
 						return m_parent->read_bytes(UINT64(blockoffs) * UINT64(m_parent->unit_bytes()), dest, m_hunkbytes);
 				}
@@ -959,9 +999,13 @@ chd_error chd_file::read_bytes(UINT64 offset, void *buffer, UINT32 bytes)
 		UINT32 startoffs = (curhunk == first_hunk) ? (offset % m_hunkbytes) : 0;
 		UINT32 endoffs = (curhunk == last_hunk) ? ((offset + bytes - 1) % m_hunkbytes) : (m_hunkbytes - 1);
 
-		// if it's a full block, just read directly from disk unless it's the cached hunk
+		// compressed images go through the decoded hunk cache
 		chd_error err = CHDERR_NONE;
-		if (startoffs == 0 && endoffs == m_hunkbytes - 1 && curhunk != m_cachehunk)
+		if (m_hcache != NULL)
+			err = hcache_read(curhunk, dest, startoffs, endoffs + 1 - startoffs);
+
+		// if it's a full block, just read directly from disk unless it's the cached hunk
+		else if (startoffs == 0 && endoffs == m_hunkbytes - 1 && curhunk != m_cachehunk)
 			err = read_hunk(curhunk, dest);
 
 		// otherwise, read from the cache
@@ -986,6 +1030,362 @@ chd_error chd_file::read_bytes(UINT64 offset, void *buffer, UINT32 bytes)
 }
 
 
+//**************************************************************************
+//  DECODED HUNK CACHE
+//**************************************************************************
+
+// cache entry states
+enum
+{
+	HCACHE_EMPTY = 0,
+	HCACHE_PENDING,                                     // being decoded, data not valid yet
+	HCACHE_READY
+};
+
+struct chd_file::hunk_cache_entry
+{
+	UINT32                  hunknum;            // hunk held in this entry
+	UINT32                  lastuse;            // LRU tick
+	int                     state;              // HCACHE_xxx
+	UINT8 *                 data;               // decoded hunk
+};
+
+
+//-------------------------------------------------
+//  hcache_init - allocate the decoded hunk cache
+//  for a read-only compressed file
+//-------------------------------------------------
+
+void chd_file::hcache_init()
+{
+	int count = HUNK_CACHE_BYTES / m_hunkbytes;
+	if (count < HUNK_CACHE_MIN)
+		count = HUNK_CACHE_MIN;
+	if (count > HUNK_CACHE_MAX)
+		count = HUNK_CACHE_MAX;
+	if (count > (int)m_hunkcount)
+		count = m_hunkcount;
+	if (count <= 0)
+		return;
+
+	m_hcache_mem = xmalloc(UINT8, count * m_hunkbytes);
+	if (m_hcache_mem == NULL)
+		return;
+	m_hcache = xcalloc(hunk_cache_entry, count);
+	for (int i = 0; i < count; i++)
+		m_hcache[i].data = m_hcache_mem + i * m_hunkbytes;
+	m_hcache_count = count;
+	m_hcache_tick = 0;
+	m_hcache_hits = m_hcache_misses = 0;
+
+	// keep the window well inside the cache so it never evicts itself
+	m_ra_depth = READAHEAD_BYTES / m_hunkbytes;
+	if (m_ra_depth < 2)
+		m_ra_depth = 2;
+	if (m_ra_depth > (UINT32)count / 2)
+		m_ra_depth = count / 2;
+	m_ra_lasthunk = ~0;
+	m_ra_next = m_ra_end = 0;
+	m_ra_waiting = 0;
+	uae_sem_init(&m_ra_lock, 0, 1);
+	uae_sem_init(&m_ra_wake, 0, 0);
+	uae_sem_init(&m_ra_done, 0, 0);
+	uae_sem_init(&m_file_lock, 0, 1);
+	uae_sem_init(&m_read_lock, 0, 1);
+}
+
+
+//-------------------------------------------------
+//  hcache_free - release the decoded hunk cache
+//-------------------------------------------------
+
+void chd_file::hcache_free()
+{
+	if (m_hcache != NULL && m_hcache_hits + m_hcache_misses > 0)
+		write_log(_T("CHD: hunk cache %d x %d, %u hits, %u misses\n"), m_hcache_count, m_hunkbytes, m_hcache_hits, m_hcache_misses);
+	xfree(m_hcache);
+	xfree(m_hcache_mem);
+	m_hcache = NULL;
+	m_hcache_mem = NULL;
+	m_hcache_count = 0;
+	uae_sem_destroy(&m_ra_lock);
+	uae_sem_destroy(&m_ra_wake);
+	uae_sem_destroy(&m_ra_done);
+	uae_sem_destroy(&m_file_lock);
+	uae_sem_destroy(&m_read_lock);
+}
+
+
+//-------------------------------------------------
+//  hcache_find - look up a hunk, m_ra_lock held
+//-------------------------------------------------
+
+chd_file::hunk_cache_entry *chd_file::hcache_find(UINT32 hunknum)
+{
+	for (int i = 0; i < m_hcache_count; i++)
+	{
+		hunk_cache_entry *e = &m_hcache[i];
+		if (e->state != HCACHE_EMPTY && e->hunknum == hunknum)
+			return e;
+	}
+	return NULL;
+}
+
+
+//-------------------------------------------------
+//  hcache_victim - pick an entry to reuse,
+//  m_ra_lock held; entries being decoded are
+//  never returned
+//-------------------------------------------------
+
+chd_file::hunk_cache_entry *chd_file::hcache_victim()
+{
+	hunk_cache_entry *victim = NULL;
+	for (int i = 0; i < m_hcache_count; i++)
+	{
+		hunk_cache_entry *e = &m_hcache[i];
+		if (e->state == HCACHE_EMPTY)
+			return e;
+		if (e->state == HCACHE_READY && (victim == NULL || (INT32)(e->lastuse - victim->lastuse) < 0))
+			victim = e;
+	}
+	return victim;
+}
+
+
+//-------------------------------------------------
+//  hcache_read - copy part of a hunk out of the
+//  cache, decoding it first if needed
+//-------------------------------------------------
+
+chd_error chd_file::hcache_read(UINT32 hunknum, UINT8 *dest, UINT32 startoffs, UINT32 length)
+{
+	if (hunknum >= m_hunkcount)
+		return CHDERR_HUNK_OUT_OF_RANGE;
+
+	readahead_request(hunknum);
+
+	for (;;)
+	{
+		uae_sem_wait(&m_ra_lock);
+		hunk_cache_entry *e = hcache_find(hunknum);
+		if (e != NULL && e->state == HCACHE_READY)
+		{
+			e->lastuse = ++m_hcache_tick;
+			memcpy(dest, e->data + startoffs, length);
+			m_hcache_hits++;
+			uae_sem_post(&m_ra_lock);
+			return CHDERR_NONE;
+		}
+		if (e != NULL)
+		{
+			// the worker or another reader is decoding it, wait for it
+			m_ra_waiting++;
+			uae_sem_post(&m_ra_lock);
+			uae_sem_wait(&m_ra_done);
+			uae_sem_wait(&m_ra_lock);
+			// one post per decode, pass it on to the next blocked reader
+			if (--m_ra_waiting > 0)
+				uae_sem_post(&m_ra_done);
+			uae_sem_post(&m_ra_lock);
+			continue;
+		}
+
+		// miss: decode it ourselves
+		m_hcache_misses++;
+		e = hcache_victim();
+		if (e == NULL)
+		{
+			uae_sem_post(&m_ra_lock);
+			uae_sem_wait(&m_read_lock);
+			chd_error err = read_hunk(hunknum, m_cache);
+			if (err == CHDERR_NONE)
+				memcpy(dest, &m_cache[startoffs], length);
+			uae_sem_post(&m_read_lock);
+			return err;
+		}
+		e->hunknum = hunknum;
+		e->state = HCACHE_PENDING;
+		uae_sem_post(&m_ra_lock);
+
+		uae_sem_wait(&m_read_lock);
+		chd_error err = read_hunk(hunknum, e->data);
+		uae_sem_post(&m_read_lock);
+
+		uae_sem_wait(&m_ra_lock);
+		if (err == CHDERR_NONE)
+		{
+			e->state = HCACHE_READY;
+			e->lastuse = ++m_hcache_tick;
+			memcpy(dest, e->data + startoffs, length);
+		}
+		else
+		{
+			e->state = HCACHE_EMPTY;
+		}
+		bool wake = m_ra_waiting > 0;
+		uae_sem_post(&m_ra_lock);
+		if (wake)
+			uae_sem_post(&m_ra_done);
+		return err;
+	}
+}
+
+
+//-------------------------------------------------
+//  readahead_request - on sequential access, ask
+//  the worker to decode the next few hunks
+//-------------------------------------------------
+
+void chd_file::readahead_request(UINT32 hunknum)
+{
+	// both CD audio and command threads read, only one may start the worker
+	uae_sem_wait(&m_ra_lock);
+	bool sequential = hunknum == m_ra_lasthunk + 1;
+	bool same = hunknum == m_ra_lasthunk;
+	m_ra_lasthunk = hunknum;
+	if (same || !sequential || hunknum + 1 >= m_hunkcount)
+	{
+		uae_sem_post(&m_ra_lock);
+		return;
+	}
+	if (m_ra_state == 0)
+		readahead_start();
+	if (m_ra_state == 0)
+	{
+		uae_sem_post(&m_ra_lock);
+		return;
+	}
+
+	UINT32 end = hunknum + 1 + m_ra_depth;
+	if (end > m_hunkcount)
+		end = m_hunkcount;
+	// keep going from where the worker is if the window only moved forward
+	if (m_ra_next <= hunknum || m_ra_next > end)
+		m_ra_next = hunknum + 1;
+	m_ra_end = end;
+	uae_sem_post(&m_ra_lock);
+	uae_sem_post(&m_ra_wake);
+}
+
+
+//-------------------------------------------------
+//  readahead_start - start the worker thread,
+//  done on first sequential access only so that
+//  probing an image does not spawn threads;
+//  m_ra_lock held
+//-------------------------------------------------
+
+void chd_file::readahead_start()
+{
+	for (int decompnum = 0; decompnum < ARRAY_LENGTH(m_ra_decompressor); decompnum++)
+	{
+		if (m_compression[decompnum] == 0)
+			continue;
+		m_ra_decompressor[decompnum] = chd_codec_list::new_decompressor(m_compression[decompnum], *this);
+		if (m_ra_decompressor[decompnum] == NULL)
+		{
+			readahead_stop();
+			return;
+		}
+	}
+	m_ra_compressed.resize(m_hunkbytes);
+	m_ra_next = m_ra_end = 0;
+	m_ra_state = 1;
+	if (!uae_start_thread(_T("chd"), readahead_thread, this, NULL))
+	{
+		m_ra_state = 0;
+		readahead_stop();
+	}
+}
+
+
+//-------------------------------------------------
+//  readahead_stop - stop the worker thread and
+//  release its resources
+//-------------------------------------------------
+
+void chd_file::readahead_stop()
+{
+	if (m_ra_state > 0)
+	{
+		m_ra_state = -1;
+		uae_sem_post(&m_ra_wake);
+		while (m_ra_state)
+			sleep_millis(1);
+	}
+	for (int decompnum = 0; decompnum < ARRAY_LENGTH(m_ra_decompressor); decompnum++)
+	{
+		delete m_ra_decompressor[decompnum];
+		m_ra_decompressor[decompnum] = NULL;
+	}
+	m_ra_compressed.reset();
+}
+
+
+//-------------------------------------------------
+//  readahead_loop - worker body: decode hunks of
+//  the requested window into the cache
+//-------------------------------------------------
+
+void chd_file::readahead_thread(void *arg)
+{
+	chd_file *chd = reinterpret_cast<chd_file *>(arg);
+	chd->readahead_loop();
+}
+
+void chd_file::readahead_loop()
+{
+	while (m_ra_state > 0)
+	{
+		uae_sem_wait(&m_ra_wake);
+		for (;;)
+		{
+			uae_sem_wait(&m_ra_lock);
+			if (m_ra_state <= 0 || m_ra_next >= m_ra_end)
+			{
+				uae_sem_post(&m_ra_lock);
+				break;
+			}
+			UINT32 hunknum = m_ra_next++;
+			if (hcache_find(hunknum) != NULL)
+			{
+				uae_sem_post(&m_ra_lock);
+				continue;
+			}
+			hunk_cache_entry *e = hcache_victim();
+			if (e == NULL)
+			{
+				uae_sem_post(&m_ra_lock);
+				break;
+			}
+			e->hunknum = hunknum;
+			e->state = HCACHE_PENDING;
+			uae_sem_post(&m_ra_lock);
+
+			// parent hunks and errors are left for the reader to handle
+			chd_error err = read_hunk_ctx(hunknum, e->data, m_ra_decompressor, m_ra_compressed, true);
+
+			uae_sem_wait(&m_ra_lock);
+			if (err == CHDERR_NONE)
+			{
+				e->state = HCACHE_READY;
+				e->lastuse = ++m_hcache_tick;
+			}
+			else
+			{
+				e->state = HCACHE_EMPTY;
+			}
+			// only signal when a reader is actually waiting
+			bool wake = m_ra_waiting > 0;
+			uae_sem_post(&m_ra_lock);
+			if (wake)
+				uae_sem_post(&m_ra_done);
+		}
+	}
+	m_ra_state = 0;
+}
+
 //-------------------------------------------------
 //  write_bytes - write to the CHD at a byte level,
 //  using the cache to handle partial hunks
@@ -2049,6 +2449,8 @@ chd_error chd_file::open_common(bool writeable)
 
 		// finish opening the file
 		create_open_common();
+		if (compressed())
+			hcache_init();
 		return CHDERR_NONE;
 	}
 
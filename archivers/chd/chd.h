@@ -20,6 +20,7 @@
 #include "corefile.h"
 #include "hashing.h"
 #include "chdcodec.h"
+#include "threaddep/thread.h"
 
 
 /***************************************************************************
@@ -381,6 +382,7 @@ private:
 	UINT8 bits_for_value(UINT64 value);
 
 	// internal helpers
+	chd_error read_hunk_ctx(UINT32 hunknum, void *buffer, chd_decompressor **decompressor, dynamic_buffer &compressed, bool readahead);
 	UINT32 guess_unitbytes();
 	void parse_v3_header(UINT8 *rawheader, sha1_t &parentsha1);
 	void parse_v4_header(UINT8 *rawheader, sha1_t &parentsha1);
@@ -399,6 +401,19 @@ private:
 	void metadata_update_hash();
 	static int CLIB_DECL metadata_hash_compare(const void *elem1, const void *elem2);
 
+	// decoded hunk cache and read-ahead
+	struct hunk_cache_entry;
+	void hcache_init();
+	void hcache_free();
+	hunk_cache_entry *hcache_find(UINT32 hunknum);
+	hunk_cache_entry *hcache_victim();
+	chd_error hcache_read(UINT32 hunknum, UINT8 *dest, UINT32 startoffs, UINT32 length);
+	void readahead_request(UINT32 hunknum);
+	void readahead_start();
+	void readahead_stop();
+	void readahead_loop();
+	static void readahead_thread(void *arg);
+
 	// file characteristics
 	core_file *             m_file;             // handle to the open core file
 	bool                    m_owns_file;        // flag indicating if this file should be closed on chd_close()
@@ -436,6 +451,29 @@ private:
 	// caching
 	dynamic_buffer          m_cache;            // single-hunk cache for partial reads/writes
 	UINT32                  m_cachehunk;        // which hunk is in the cache?
+
+	// decoded hunk cache, used for read-only compressed files
+	hunk_cache_entry *      m_hcache;           // array of cache entries
+	UINT8 *                 m_hcache_mem;       // backing store for all entries
+	int                     m_hcache_count;     // number of entries
+	UINT32                  m_hcache_tick;      // LRU clock
+	UINT32                  m_hcache_hits;      // statistics
+	UINT32                  m_hcache_misses;
+
+	// read-ahead worker
+	volatile int            m_ra_state;         // 1 = running, -1 = stop requested, 0 = stopped
+	UINT32                  m_ra_lasthunk;      // last hunk read, for sequential detection
+	UINT32                  m_ra_next;          // next hunk the worker should decode
+	UINT32                  m_ra_end;           // end of the requested window
+	UINT32                  m_ra_depth;         // window size in hunks
+	uae_sem_t               m_ra_lock;          // protects cache entries and the window
+	uae_sem_t               m_ra_wake;          // work available
+	uae_sem_t               m_ra_done;          // a hunk finished decoding
+	int                     m_ra_waiting;       // readers blocked on m_ra_done, m_ra_lock held
+	uae_sem_t               m_file_lock;        // serializes file access with the worker
+	uae_sem_t               m_read_lock;        // serializes readers using m_decompressor/m_compressed/m_cache
+	chd_decompressor *      m_ra_decompressor[4];// worker's own codec instances
+	dynamic_buffer          m_ra_compressed;    // worker's compressed data buffer
 };
 
 
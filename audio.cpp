@@ -49,6 +49,10 @@
 #include "threaddep/thread.h"
 
 #include <math.h>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define AUDIO_FIR_SSE 1
+#endif
 
 #define DEBUG_AUDIO 0
 #define DEBUG_AUDIO2 0
@@ -161,7 +165,8 @@ struct audio_channel_data
 	uaecptr dmaofftime_pc;
 	int minperloop;
 	int volcntbufcnt;
-	float volcntbuf[VOLCNT_BUFFER_SIZE];
+	// first 2 * FIR_WIDTH entries are mirrored after the end so that FIR window is always contiguous
+	float volcntbuf[VOLCNT_BUFFER_SIZE + 2 * FIR_WIDTH];
 };
 
 static int audio_extra_streams[AUDIO_CHANNEL_STREAMS];
@@ -2318,6 +2323,37 @@ void set_audio (void)
 	cd_audio_mode_changed = true;
 }
 
+/* out0 = FIR over buf[0..], out1 = same FIR one sample later */
+static void volcnt_fir(const float *buf, float *out0p, float *out1p)
+{
+	const float *fir = firmem + 1;
+	const int taps = 2 * FIR_WIDTH - 2;
+	int j = 0;
+#if AUDIO_FIR_SSE
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (; j + 4 <= taps; j += 4) {
+		__m128 w = _mm_loadu_ps(fir + j);
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(buf + j), w));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(buf + j + 1), w));
+	}
+	float tmp0[4], tmp1[4];
+	_mm_storeu_ps(tmp0, acc0);
+	_mm_storeu_ps(tmp1, acc1);
+	float out0 = (tmp0[0] + tmp0[1]) + (tmp0[2] + tmp0[3]);
+	float out1 = (tmp1[0] + tmp1[1]) + (tmp1[2] + tmp1[3]);
+#else
+	float out0 = 0, out1 = 0;
+#endif
+	for (; j < taps; j++) {
+		float w = fir[j];
+		out0 += buf[j] * w;
+		out1 += buf[j + 1] * w;
+	}
+	*out0p = out0;
+	*out1p = out1;
+}
+
 static void update_audio_volcnt(int cycles, float evtime, bool nextsmp)
 {
 	if (cycles) {
@@ -2328,10 +2364,10 @@ static void update_audio_volcnt(int cycles, float evtime, bool nextsmp)
 			v.F32 -= 3.0;
 			int cycs = cycles;
 			while (cycs > 0) {
-				if (cdp->volcnt < cdp->data.audvol) {
-					cdp->volcntbuf[cdp->volcntbufcnt] = v.F32;
-				} else {
-					cdp->volcntbuf[cdp->volcntbufcnt] = 0;
+				float f = cdp->volcnt < cdp->data.audvol ? v.F32 : 0;
+				cdp->volcntbuf[cdp->volcntbufcnt] = f;
+				if (cdp->volcntbufcnt < 2 * FIR_WIDTH) {
+					cdp->volcntbuf[cdp->volcntbufcnt + VOLCNT_BUFFER_SIZE] = f;
 				}
 				cdp->volcntbufcnt++;
 				cdp->volcntbufcnt &= (VOLCNT_BUFFER_SIZE - 1);
@@ -2346,17 +2382,9 @@ static void update_audio_volcnt(int cycles, float evtime, bool nextsmp)
 	float frac = evtime - (int)evtime;
 	for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
 		struct audio_channel_data *cdp = audio_channel + i;
-		float out0 = 0, out1 = 0;
+		float out0, out1;
 		int offs = (cdp->volcntbufcnt - FIR_WIDTH - 1) & (VOLCNT_BUFFER_SIZE - 1);
-		float v = cdp->volcntbuf[offs];
-		for (int j = 1; j < 2 * FIR_WIDTH - 1; j++) {
-			float w = firmem[j];
-			out0 += v * w;
-			offs++;
-			offs &= (VOLCNT_BUFFER_SIZE - 1);
-			v = cdp->volcntbuf[offs];
-			out1 += v * w;
-		}
+		volcnt_fir(cdp->volcntbuf + offs, &out0, &out1);
 		float out = out0 + frac * (out1 - out0);
 		out *= 8192;
 
@@ -68,13 +68,27 @@ struct cdtoc
 	int pregap; // sectors of silence
 	int postgap; // sectors of silence
 	audenc enctype;
-	int writeoffset;
 	int subcode;
+	// MP3/FLAC decoding into data, CDDA_UNPACK_CHUNK sized pieces
+	volatile uae_u8 *unpackstate; // 0 = not decoded, 1 = decoding, 2 = done
+	int unpackchunks, unpackchunksize;
+	volatile int unpacked; // MP3: bytes decoded so far
 #ifdef WITH_CHD
 	const cdrom_track_info *chdtrack;
 #endif
 };
 
+#define CDIMAGE_RA_SECTORS 32
+
+struct cdreadahead
+{
+	struct cdtoc *t;
+	uae_s64 pos;
+	int len;
+	int bufsize;
+	uae_u8 *buf;
+};
+
 struct cdunit {
 	bool enabled;
 	bool open;
@@ -107,13 +121,28 @@ struct cdunit {
 	volatile int cda_bufon[2];
 	cda_audio *cda;
 	struct cd_audio_state cas;
+
+	/* sequential read-ahead for images that can't be accessed in place */
+	uae_sem_t ra_sem, ra_wake, ra_done;
+	struct cdreadahead ra[2]; // current window, prefetched window
+	volatile bool ra_busy; // prefetch thread owns ra[1] and image handles
+	volatile int ra_state;
+	struct cdtoc *ra_reqt;
+	uae_s64 ra_reqpos;
+	struct cdtoc *ra_lastt;
+	int ra_lastsector, ra_seq;
+
+	/* CD audio decode workers, decode around unpack_t/unpack_pos first */
+	uae_sem_t unpack_sem, unpack_wake;
+	volatile uae_atomic unpack_threads;
+	volatile bool unpack_quit;
+	struct cdtoc *volatile unpack_t, *volatile unpack_next;
+	volatile int unpack_pos;
 };
 
 static struct cdunit cdunits[MAX_TOTAL_SCSI_DEVICES];
 static int bus_open;
 
-static volatile int cdimage_unpack_thread, cdimage_unpack_active;
-static smp_comm_pipe unpack_pipe;
 static uae_sem_t play_sem;
 
 static struct cdunit *unitisopen (int unitnum)
@@ -151,6 +180,154 @@ static struct cdtoc *findtoc (struct cdunit *cdu, int *sectorp, bool data)
 	return NULL;
 }
 
+/* Exclusive use of the image handles, waits for a running prefetch. */
+static void cdimage_io_begin(struct cdunit *cdu)
+{
+	uae_sem_wait(&cdu->ra_sem);
+	while (cdu->ra_busy) {
+		uae_sem_post(&cdu->ra_sem);
+		uae_sem_wait(&cdu->ra_done);
+		uae_sem_wait(&cdu->ra_sem);
+	}
+}
+static void cdimage_io_end(struct cdunit *cdu)
+{
+	uae_sem_post(&cdu->ra_sem);
+}
+
+static bool cdimage_ra_fill(struct cdreadahead *ra, struct cdtoc *t, uae_s64 pos)
+{
+	uae_s64 fsize = zfile_size(t->handle);
+	int len = CDIMAGE_RA_SECTORS * (t->size + t->skipsize);
+
+	ra->t = NULL;
+	if (pos + len > fsize)
+		len = (int)(fsize - pos);
+	if (len <= 0)
+		return false;
+	if (len > ra->bufsize) {
+		xfree(ra->buf);
+		ra->buf = xmalloc(uae_u8, len);
+		ra->bufsize = ra->buf ? len : 0;
+		if (!ra->buf)
+			return false;
+	}
+	zfile_fseek(t->handle, pos, SEEK_SET);
+	len = (int)zfile_fread(ra->buf, 1, len, t->handle);
+	if (len <= 0)
+		return false;
+	ra->t = t;
+	ra->pos = pos;
+	ra->len = len;
+	return true;
+}
+
+static bool cdimage_ra_get(struct cdreadahead *ra, struct cdtoc *t, uae_s64 pos, uae_u8 *data, int size)
+{
+	if (ra->t != t || pos < ra->pos || pos + size > ra->pos + ra->len)
+		return false;
+	memcpy(data, ra->buf + (pos - ra->pos), size);
+	return true;
+}
+
+static void cdimage_readahead_func(void *v)
+{
+	struct cdunit *cdu = (struct cdunit*)v;
+
+	cdu->ra_state = 1;
+	for (;;) {
+		uae_sem_wait(&cdu->ra_wake);
+		if (cdu->ra_state < 0)
+			break;
+		if (!cdu->ra_busy)
+			continue;
+		cdimage_ra_fill(&cdu->ra[1], cdu->ra_reqt, cdu->ra_reqpos);
+		uae_sem_wait(&cdu->ra_sem);
+		cdu->ra_busy = false;
+		uae_sem_post(&cdu->ra_sem);
+		uae_sem_post(&cdu->ra_done);
+	}
+	cdu->ra_state = 0;
+}
+
+/* Read from image file. Once sectors are read in order, data comes from
+ * CDIMAGE_RA_SECTORS sized windows and the next window is prefetched in
+ * the background while the current one is consumed. */
+static int cdimage_read(struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int sector, uae_s64 pos, int size)
+{
+	int ssize = t->size + t->skipsize;
+	int ret = 1;
+
+	uae_sem_wait(&cdu->ra_sem);
+	if (t == cdu->ra_lastt && sector == cdu->ra_lastsector + 1)
+		cdu->ra_seq++;
+	else if (t != cdu->ra_lastt || sector != cdu->ra_lastsector)
+		cdu->ra_seq = 0;
+	cdu->ra_lastt = t;
+	cdu->ra_lastsector = sector;
+	bool streaming = cdu->ra_seq >= 2 && (t->enctype == AUDENC_NONE || t->enctype == AUDENC_PCM);
+
+	if (!cdimage_ra_get(&cdu->ra[0], t, pos, data, size)) {
+		while (cdu->ra_busy) {
+			uae_sem_post(&cdu->ra_sem);
+			uae_sem_wait(&cdu->ra_done);
+			uae_sem_wait(&cdu->ra_sem);
+		}
+		if (cdimage_ra_get(&cdu->ra[1], t, pos, data, size)) {
+			struct cdreadahead tmp = cdu->ra[0];
+			cdu->ra[0] = cdu->ra[1];
+			cdu->ra[1] = tmp;
+			cdu->ra[1].t = NULL;
+		} else if (!streaming || !cdimage_ra_fill(&cdu->ra[0], t, t->offset + (uae_s64)sector * ssize) || !cdimage_ra_get(&cdu->ra[0], t, pos, data, size)) {
+			zfile_fseek(t->handle, pos, SEEK_SET);
+			ret = zfile_fread(data, 1, size, t->handle) == size;
+			streaming = false;
+		}
+	}
+	if (streaming && !cdu->ra_busy && cdu->ra[0].t == t) {
+		uae_s64 next = cdu->ra[0].pos + cdu->ra[0].len;
+		if ((cdu->ra[1].t != t || cdu->ra[1].pos != next) && next < zfile_size(t->handle)) {
+			cdu->ra_reqt = t;
+			cdu->ra_reqpos = next;
+			cdu->ra_busy = true;
+			uae_sem_post(&cdu->ra_wake);
+		}
+	}
+	uae_sem_post(&cdu->ra_sem);
+	return ret;
+}
+
+static void cdimage_readahead_start(struct cdunit *cdu)
+{
+	uae_sem_init(&cdu->ra_sem, 0, 1);
+	uae_sem_init(&cdu->ra_wake, 0, 0);
+	uae_sem_init(&cdu->ra_done, 0, 0);
+	cdu->ra_busy = false;
+	cdu->ra_lastt = NULL;
+	cdu->ra_seq = 0;
+	cdu->ra_state = 0;
+	uae_start_thread(_T("cdimage_readahead"), cdimage_readahead_func, cdu, NULL);
+	while (cdu->ra_state == 0)
+		sleep_millis(1);
+}
+
+static void cdimage_readahead_stop(struct cdunit *cdu)
+{
+	cdimage_io_begin(cdu);
+	cdu->ra_state = -1;
+	cdimage_io_end(cdu);
+	uae_sem_post(&cdu->ra_wake);
+	while (cdu->ra_state)
+		sleep_millis(1);
+	for (int i = 0; i < 2; i++) {
+		xfree(cdu->ra[i].buf);
+		memset(&cdu->ra[i], 0, sizeof(struct cdreadahead));
+	}
+	uae_sem_destroy(&cdu->ra_done);
+	uae_sem_destroy(&cdu->ra_wake);
+	uae_sem_destroy(&cdu->ra_sem);
+}
+
 static int do_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int sector, int offset, int size, bool audio)
 {
 	if (t->enctype == ENC_CHD) {
@@ -184,16 +361,35 @@ static int do_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int secto
 #endif
 	} else if (t->handle) {
 		int ssize = t->size + t->skipsize;
-		zfile_fseek (t->handle, t->offset + (uae_u64)sector * ssize + offset, SEEK_SET);
-		return zfile_fread (data, 1, size, t->handle) == size;
+		uae_u64 pos = t->offset + (uae_u64)sector * ssize + offset;
+		cdimage_io_begin(cdu);
+		const uae_u8 *p = zfile_get_data_range (t->handle, pos, size);
+		if (p)
+			memcpy (data, p, size);
+		cdimage_io_end(cdu);
+		if (p)
+			return 1;
+		return cdimage_read(cdu, t, data, sector, pos, size);
 	}
 	return 0;
 }
 
 // WOHOO, library that supports virtual file access functions. Perfect!
+#define CDDA_UNPACK_CHUNK (2352 * 75 * 2)
+#define CDDA_UNPACK_THREADS 2
+
+// decoder instance state, each worker has its own file position
+struct cdunpack
+{
+	struct cdunit *cdu;
+	struct cdtoc *t;
+	uae_s64 fpos;
+	int writeoffset, writeend;
+};
+
 static void flac_metadata_callback (const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
+	struct cdtoc *t = ((struct cdunpack*)client_data)->t;
 	if (t->data)
 		return;
 	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
@@ -208,48 +404,69 @@ static void flac_error_callback (const FLAC__StreamDecoder *decoder, FLAC__Strea
 }
 static FLAC__StreamDecoderWriteStatus flac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	uae_u16 *p = (uae_u16*)(t->data + t->writeoffset);
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	struct cdtoc *t = up->t;
+	uae_u16 *p = (uae_u16*)(t->data + up->writeoffset);
 	int size = 4;
-	for (int i = 0; i < frame->header.blocksize && t->writeoffset < t->filesize - size; i++, t->writeoffset += size) {
+	for (int i = 0; i < frame->header.blocksize && up->writeoffset < up->writeend && up->writeoffset < t->filesize - size; i++, up->writeoffset += size) {
 		*p++ = (FLAC__int16)buffer[0][i];
 		*p++ = (FLAC__int16)buffer[1][i];
 	}
+	if (up->writeoffset >= up->writeend || (up->cdu && up->cdu->unpack_quit))
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
+static bool mp3_progress_callback (int decoded, void *userdata)
+{
+	struct cdunpack *up = (struct cdunpack*)userdata;
+	up->t->unpacked = decoded;
+	return !up->cdu->unpack_quit;
+}
 static FLAC__StreamDecoderReadStatus file_read_callback (const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	if (zfile_ftell (t->handle) >= zfile_size (t->handle))
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	struct cdtoc *t = up->t;
+	if (up->fpos >= zfile_size (t->handle))
 		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
-	return zfile_fread (buffer, *bytes, 1, t->handle) ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+	// handle is shared with other decoders and the data read path
+	if (up->cdu)
+		cdimage_io_begin (up->cdu);
+	zfile_fseek (t->handle, up->fpos, SEEK_SET);
+	size_t len = zfile_fread (buffer, 1, *bytes, t->handle);
+	if (up->cdu)
+		cdimage_io_end (up->cdu);
+	up->fpos += len;
+	*bytes = len;
+	return len ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_ABORT;
 }
 static FLAC__StreamDecoderSeekStatus file_seek_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	zfile_fseek (t->handle, absolute_byte_offset, SEEK_SET);
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	up->fpos = absolute_byte_offset;
 	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
 }
 static FLAC__StreamDecoderTellStatus file_tell_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	*absolute_byte_offset = zfile_ftell (t->handle);
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	*absolute_byte_offset = up->fpos;
 	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
 }
 static FLAC__StreamDecoderLengthStatus file_len_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	*stream_length = zfile_size (t->handle);
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	*stream_length = zfile_size (up->t->handle);
 	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
 }
 static FLAC__bool file_eof_callback (const FLAC__StreamDecoder *decoder, void *client_data)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	return zfile_ftell (t->handle) >= zfile_size (t->handle);
+	struct cdunpack *up = (struct cdunpack*)client_data;
+	return up->fpos >= zfile_size (up->t->handle);
 }
 
 static void flac_get_size (struct cdtoc *t)
 {
+	struct cdunpack up = { 0 };
+	up.t = t;
 	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new ();
 	if (decoder) {
 		FLAC__stream_decoder_set_md5_checking (decoder, false);
@@ -257,27 +474,38 @@ static void flac_get_size (struct cdtoc *t)
 		int init_status = FLAC__stream_decoder_init_stream (decoder,
 			&file_read_callback, &file_seek_callback, &file_tell_callback,
 			&file_len_callback, &file_eof_callback,
-			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t);
+			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, &up);
 		FLAC__stream_decoder_process_until_end_of_metadata (decoder);
 		FLAC__stream_decoder_delete (decoder);
 	}
 }
-static uae_u8 *flac_get_data (struct cdtoc *t)
+// decode bytes [start, end) of the track into t->data
+static void flac_get_data (struct cdunit *cdu, struct cdtoc *t, int start, int end)
 {
-	write_log (_T("FLAC: unpacking '%s'..\n"), zfile_getname (t->handle));
-	t->writeoffset = 0;
+	struct cdunpack up = { 0 };
+	up.cdu = cdu;
+	up.t = t;
+	up.writeoffset = start;
+	up.writeend = end;
 	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new ();
 	if (decoder) {
 		FLAC__stream_decoder_set_md5_checking (decoder, false);
 		int init_status = FLAC__stream_decoder_init_stream (decoder,
 			&file_read_callback, &file_seek_callback, &file_tell_callback,
 			&file_len_callback, &file_eof_callback,
-			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t);
-		FLAC__stream_decoder_process_until_end_of_stream (decoder);
+			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, &up);
+		if (start == 0 || FLAC__stream_decoder_seek_absolute (decoder, start / 4)) {
+			while (up.writeoffset < end && !cdu->unpack_quit) {
+				if (!FLAC__stream_decoder_process_single (decoder))
+					break;
+				if (FLAC__stream_decoder_get_state (decoder) == FLAC__STREAM_DECODER_END_OF_STREAM)
+					break;
+			}
+		} else {
+			write_log (_T("FLAC: '%s' seek to %d failed\n"), zfile_getname (t->handle), start);
+		}
 		FLAC__stream_decoder_delete (decoder);
-		write_log (_T("FLAC: %s unpacked\n"), zfile_getname (t->handle));
 	}
-	return t->data;
 }
 
 void sub_to_interleaved (const uae_u8 *s, uae_u8 *d)
@@ -325,9 +553,11 @@ static int getsub_deinterleaved (uae_u8 *dst, struct cdunit *cdu, struct cdtoc *
 				totalsize += t->size;
 				offset = t->size;
 			}
+			cdimage_io_begin(cdu);
 			zfile_fseek (t->subhandle, (uae_u64)sector * totalsize + t->suboffset + offset, SEEK_SET);
 			if (zfile_fread (dst, SUB_CHANNEL_SIZE, 1, t->subhandle) > 0)
 				ret = t->subcode;
+			cdimage_io_end(cdu);
 		} else {
 			memcpy (dst, t->subdata + sector * SUB_CHANNEL_SIZE + t->suboffset, SUB_CHANNEL_SIZE);
 			ret = t->subcode;
@@ -389,60 +619,193 @@ static int setstate (struct cdunit *cdu, int state, int playpos)
 	return 0;
 }
 
+// next chunk to decode: current track from the play position onwards,
+// then the rest of it, then the following track
+static bool cdda_unpack_pick (struct cdunit *cdu, struct cdtoc **tp, int *chunkp)
+{
+	struct cdtoc *t = cdu->unpack_t;
+	for (int pass = 0; pass < 2 && t; pass++) {
+		if (t->unpackstate) {
+			int first = pass == 0 ? cdu->unpack_pos / t->unpackchunksize : 0;
+			if (first < 0 || first >= t->unpackchunks)
+				first = 0;
+			for (int i = 0; i < t->unpackchunks; i++) {
+				int c = (first + i) % t->unpackchunks;
+				if (t->unpackstate[c] == 0) {
+					t->unpackstate[c] = 1;
+					*tp = t;
+					*chunkp = c;
+					return true;
+				}
+			}
+		}
+		t = cdu->unpack_next;
+	}
+	return false;
+}
+
 static void cdda_unpack_func (void *v)
 {
-	cdimage_unpack_thread = 1;
+	struct cdunit *cdu = (struct cdunit*)v;
 	mp3decoder *mp3dec = NULL;
 
+	atomic_inc (&cdu->unpack_threads);
 	for (;;) {
-		uae_u32 cduidx = read_comm_pipe_u32_blocking (&unpack_pipe);
-		if (cdimage_unpack_thread == 0)
+		struct cdtoc *t;
+		int chunk;
+
+		uae_sem_wait (&cdu->unpack_sem);
+		bool found = !cdu->unpack_quit && cdda_unpack_pick (cdu, &t, &chunk);
+		uae_sem_post (&cdu->unpack_sem);
+		if (cdu->unpack_quit)
 			break;
-		uae_u32 tocidx = read_comm_pipe_u32_blocking (&unpack_pipe);
-		struct cdunit *cdu = &cdunits[cduidx];
-		struct cdtoc *t = &cdu->toc[tocidx];
-		if (t->handle) {
+		if (!found) {
+			uae_sem_wait (&cdu->unpack_wake);
+			continue;
+		}
+		// let the other worker look for more work
+		uae_sem_post (&cdu->unpack_wake);
+
+		if (chunk == 0) {
 			// force unpack if handle points to delayed zipped file
+			cdimage_io_begin (cdu);
 			uae_s64 pos = zfile_ftell (t->handle);
 			zfile_fseek (t->handle, -1, SEEK_END);
 			uae_u8 b;
 			zfile_fread (&b, 1, 1, t->handle);
 			zfile_fseek (t->handle, pos, SEEK_SET);
-			if (!t->data && (t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC)) {
-				t->data = xcalloc (uae_u8, (int)t->filesize + 2352);
-				cdimage_unpack_active = 1;
-				if (t->data) {
-					if (t->enctype == AUDENC_MP3) {
-						if (!mp3dec) {
-							try {
-								mp3dec = new mp3decoder();
-							} catch (exception) { };
-						}
-						if (mp3dec)
-							t->data = mp3dec->get (t->handle, t->data, (int)t->filesize);
-					} else if (t->enctype == AUDENC_FLAC) {
-						flac_get_data (t);
-					}
+			cdimage_io_end (cdu);
+		}
+		if (t->enctype == AUDENC_MP3) {
+			if (!mp3dec) {
+				try {
+					mp3dec = new mp3decoder();
+				} catch (exception) { };
+			}
+			if (mp3dec) {
+				// decode from a private copy, the image handles are shared
+				cdimage_io_begin (cdu);
+				uae_s64 pos = zfile_ftell (t->handle);
+				struct zfile *zf = zfile_fopen_load_zfile (t->handle);
+				zfile_fseek (t->handle, pos, SEEK_SET);
+				cdimage_io_end (cdu);
+				if (zf) {
+					struct cdunpack up = { 0 };
+					up.cdu = cdu;
+					up.t = t;
+					mp3dec->get (zf, t->data, (int)t->filesize, mp3_progress_callback, &up);
+					zfile_fclose (zf);
 				}
 			}
+		} else if (t->enctype == AUDENC_FLAC) {
+			int start = chunk * t->unpackchunksize;
+			int end = start + t->unpackchunksize;
+			if (end > t->filesize)
+				end = (int)t->filesize;
+			flac_get_data (cdu, t, start, end);
 		}
-		cdimage_unpack_active = 2;
+		t->unpackstate[chunk] = 2;
 	}
 	delete mp3dec;
-	cdimage_unpack_thread = -1;
+	atomic_dec (&cdu->unpack_threads);
+}
+
+static void cdda_unpack_alloc (struct cdtoc *t)
+{
+	if (t->unpackstate || !t->handle)
+		return;
+	if (t->enctype == AUDENC_FLAC) {
+		t->unpackchunksize = CDDA_UNPACK_CHUNK;
+		t->unpackchunks = (int)((t->filesize + CDDA_UNPACK_CHUNK - 1) / CDDA_UNPACK_CHUNK);
+	} else {
+		// MP3 can only be decoded from the start, other tracks only need the forced unpack
+		t->unpackchunksize = (int)t->filesize + 2352;
+		t->unpackchunks = 1;
+	}
+	if (t->unpackchunks <= 0)
+		return;
+	if ((t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC) && !t->data) {
+		t->data = xcalloc (uae_u8, (int)t->filesize + 2352);
+		if (!t->data)
+			return;
+	}
+	t->unpacked = 0;
+	t->unpackstate = xcalloc (uae_u8, t->unpackchunks);
+}
+
+// play position moved, decode around it first
+static void cdda_unpack_seek (struct cdunit *cdu, struct cdtoc *t, int pos)
+{
+	uae_sem_wait (&cdu->unpack_sem);
+	cdu->unpack_t = t;
+	cdu->unpack_pos = pos;
+	uae_sem_post (&cdu->unpack_sem);
+	uae_sem_post (&cdu->unpack_wake);
+}
+
+static bool cdda_unpack_ready (struct cdtoc *t, int pos, int size)
+{
+	if (!t->unpackstate)
+		return false;
+	if (t->enctype == AUDENC_MP3)
+		return t->unpackstate[0] == 2 || t->unpacked >= pos + size;
+	for (int c = pos / t->unpackchunksize; c <= (pos + size - 1) / t->unpackchunksize && c < t->unpackchunks; c++) {
+		if (t->unpackstate[c] != 2)
+			return false;
+	}
+	return true;
+}
+
+// workers are started on first audio play, data-only units never get them
+static void cdda_unpack_threads (struct cdunit *cdu)
+{
+	if (cdu->unpack_threads > 0)
+		return;
+	for (int i = 0; i < CDDA_UNPACK_THREADS; i++)
+		uae_start_thread (_T("cdimage_unpack"), cdda_unpack_func, cdu, NULL);
+	while (cdu->unpack_threads < CDDA_UNPACK_THREADS)
+		sleep_millis (1);
 }
 
 static void audio_unpack(struct cdunit *cdu, struct cdtoc *t)
 {
 	// do this even if audio is not compressed, t->handle also could be
 	// compressed and we want to unpack it in background too
-	while (cdimage_unpack_active == 1)
-		sleep_millis(10);
-	cdimage_unpack_active = 0;
-	write_comm_pipe_u32(&unpack_pipe, addrdiff(cdu, &cdunits[0]), 0);
-	write_comm_pipe_u32(&unpack_pipe, addrdiff(t, &cdu->toc[0]), 1);
-	while (cdimage_unpack_active == 0)
-		sleep_millis(10);
+	uae_sem_wait (&cdu->unpack_sem);
+	cdda_unpack_threads (cdu);
+	cdda_unpack_alloc (t);
+	struct cdtoc *next = t + 1;
+	if (addrdiff(next, &cdu->toc[0]) < cdu->tracks && !(next->ctrl & 4)) {
+		cdda_unpack_alloc (next);
+		cdu->unpack_next = next;
+	} else {
+		cdu->unpack_next = NULL;
+	}
+	cdu->unpack_t = t;
+	cdu->unpack_pos = 0;
+	uae_sem_post (&cdu->unpack_sem);
+	uae_sem_post (&cdu->unpack_wake);
+}
+
+static void cdda_unpack_start (struct cdunit *cdu)
+{
+	uae_sem_init (&cdu->unpack_sem, 0, 1);
+	uae_sem_init (&cdu->unpack_wake, 0, 0);
+	cdu->unpack_quit = false;
+	cdu->unpack_t = cdu->unpack_next = NULL;
+	cdu->unpack_threads = 0;
+}
+
+static void cdda_unpack_stop (struct cdunit *cdu)
+{
+	cdu->unpack_quit = true;
+	while (cdu->unpack_threads > 0) {
+		uae_sem_post (&cdu->unpack_wake);
+		sleep_millis (1);
+	}
+	cdu->unpack_t = cdu->unpack_next = NULL;
+	uae_sem_destroy (&cdu->unpack_wake);
+	uae_sem_destroy (&cdu->unpack_sem);
 }
 
 static void next_cd_audio_buffer_callback(int bufnum, void *params)
@@ -603,6 +966,7 @@ static bool cdda_play_func2 (struct cdunit *cdu, int *outpos)
 			setstate(cdu, AUDIO_STATUS_IN_PROGRESS, cdda_pos);
 
 			memset (cdu->cda->buffers[bufnum], 0, CDDA_BUFFERS * 2352);
+			bool unpackwait = false;
 
 			for (cnt = 0; cnt < CDDA_BUFFERS && cdu->cdda_play > 0; cnt++) {
 				uae_u8 *dst = cdu->cda->buffers[bufnum] + cnt * 2352;
@@ -635,12 +999,27 @@ static bool cdda_play_func2 (struct cdunit *cdu, int *outpos)
 							int offset = (int)t->offset;
 							if (offset >= 0) {
 								if ((t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC) && t->data) {
-									if (t->filesize >= sector * totalsize + offset + t->size)
-										memcpy (dst, t->data + sector * totalsize + offset, t->size);
+									int pos = sector * totalsize + offset;
+									if (t->filesize >= pos + t->size) {
+										if (!cdda_unpack_ready (t, pos, t->size)) {
+											// not decoded yet: wait a moment, then play silence
+											cdda_unpack_seek (cdu, t, pos);
+											for (int w = 0; !unpackwait && w < 100 && cdu->cdda_play > 0; w++) {
+												if (cdda_unpack_ready (t, pos, t->size))
+													break;
+												sleep_millis (1);
+											}
+											if (!cdda_unpack_ready (t, pos, t->size))
+												unpackwait = true;
+										}
+										if (cdda_unpack_ready (t, pos, t->size))
+											memcpy (dst, t->data + pos, t->size);
+										else
+											cdda_unpack_seek (cdu, t, pos);
+									}
 								} else if (t->enctype == AUDENC_PCM) {
 									if (sector * totalsize + offset + totalsize < t->filesize) {
-										zfile_fseek (t->handle, (uae_u64)sector * totalsize + offset, SEEK_SET);
-										zfile_fread (dst, t->size, 1, t->handle);
+										do_read (cdu, t, dst, sector, 0, t->size, true);
 									}
 								}
 							}
@@ -720,9 +1099,6 @@ end:
 	if (restart)
 		audio_cda_new_buffer(&cdu->cas, NULL, -1, -1, NULL, NULL);
 
-	while (cdimage_unpack_active == 1)
-		sleep_millis(10);
-
 	delete cdu->cda;
 
 	write_log (_T("IMAGE CDDA: thread killed (%s)\n"), restart ? _T("restart") : _T("play end"));
@@ -1410,7 +1786,7 @@ static int parsemds (struct cdunit *cdu, struct zfile *zmds, const TCHAR *img, c
 					fname = my_strdup (newname);
 				}
 
-				t->handle = zfile_fopen (fname, _T("rb"), ZFD_NORMAL);
+				t->handle = zfile_fopen (fname, _T("rb"), ZFD_NORMAL | ZFD_MMAP);
 				t->fname = my_strdup (fname);
 				if (t->handle)
 					t->filesize = zfile_size (t->handle);
@@ -1542,7 +1918,7 @@ static int parseccd (struct cdunit *cdu, struct zfile *zcue, const TCHAR *img, c
 	if (ext)
 		*ext = 0;
 	_tcscat (fname, _T(".img"));
-	zimg = zfile_fopen (fname, _T("rb"), ZFD_NORMAL);
+	zimg = zfile_fopen (fname, _T("rb"), ZFD_NORMAL | ZFD_MMAP);
 	if (!zimg) {
 		write_log (_T("CCD: can't open '%s'\n"), fname);
 		return 0;
@@ -1770,14 +2146,14 @@ static int parsecue (struct cdunit *cdu, struct zfile *zcue, const TCHAR *img, c
 				}
 
 				newfile = 0;
-				ztrack = zfile_fopen (fname, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN);
+				ztrack = zfile_fopen (fname, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN | ZFD_MMAP);
 				if (!ztrack) {
 					TCHAR tmp[MAX_DPATH];
 					_tcscpy (tmp, fname);
 					p = tmp + _tcslen (tmp);
 					while (p > tmp) {
 						if (*p == '/' || *p == '\\') {
-							ztrack = zfile_fopen (p + 1, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN);
+							ztrack = zfile_fopen (p + 1, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN | ZFD_MMAP);
 							if (ztrack) {
 								xfree (fname);
 								fname = my_strdup (p + 1);
@@ -1798,7 +2174,7 @@ static int parsecue (struct cdunit *cdu, struct zfile *zcue, const TCHAR *img, c
 						s2[0] = 0;
 						_tcscat (tmp, FSDB_DIR_SEPARATOR_S);
 						_tcscat (tmp, fname);
-						ztrack = zfile_fopen (tmp, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN);
+						ztrack = zfile_fopen (tmp, _T("rb"), ZFD_ARCHIVE | ZFD_DELAYEDOPEN | ZFD_MMAP);
 					}
 				}
 				t->track = tracknum;
@@ -2115,7 +2491,7 @@ static int parse_image (struct cdunit *cdu, const TCHAR *img)
 	cdu->tracks = 0;
 	if (!img)
 		return 0;
-	zcue = zfile_fopen (img, _T("rb"), ZFD_ARCHIVE | ZFD_CD | ZFD_DELAYEDOPEN);
+	zcue = zfile_fopen (img, _T("rb"), ZFD_ARCHIVE | ZFD_CD | ZFD_DELAYEDOPEN | ZFD_MMAP);
 	if (!zcue)
 		return 0;
 
@@ -2281,6 +2657,7 @@ static void unload_image (struct cdunit *cdu)
 			zfile_fclose (t->subhandle);
 		xfree (t->fname);
 		xfree (t->data);
+		xfree ((void*)t->unpackstate);
 		xfree (t->subdata);
 		xfree (t->extrainfo);
 	}
@@ -2304,6 +2681,7 @@ static int open_device (int unitnum, const TCHAR *ident, int flags)
 
 	if (!cdu->open) {
 		uae_sem_init (&cdu->sub_sem, 0, 1);
+		cdimage_readahead_start (cdu);
 		cdu->imgname_out[0] = 0;
 		cdu->imgname_in[0] = 0;
 		if (ident) {
@@ -2315,12 +2693,7 @@ static int open_device (int unitnum, const TCHAR *ident, int flags)
 		cdu->enabled = true;
 		cdu->cdda_volume[0] = 0x7fff;
 		cdu->cdda_volume[1] = 0x7fff;
-		if (cdimage_unpack_thread == 0) {
-			init_comm_pipe (&unpack_pipe, 10, 1);
-			uae_start_thread (_T("cdimage_unpack"), cdda_unpack_func, NULL, NULL);
-			while (cdimage_unpack_thread == 0)
-				Sleep (10);
-		}
+		cdda_unpack_start (cdu);
 		ret = 1;
 	}
 	blkdev_cd_change (unitnum, cdu->imgname_out);
@@ -2333,15 +2706,8 @@ static void close_device (int unitnum)
 	if (cdu->open) {
 		cdda_stop (cdu);
 		cdu->open = false;
-		if (cdimage_unpack_thread) {
-			cdimage_unpack_thread = 0;
-			write_comm_pipe_u32 (&unpack_pipe, -1, 0);
-			write_comm_pipe_u32 (&unpack_pipe, -1, 1);
-			while (cdimage_unpack_thread == 0)
-				Sleep (10);
-			cdimage_unpack_thread = 0;
-			destroy_comm_pipe (&unpack_pipe);
-		}
+		cdda_unpack_stop (cdu);
+		cdimage_readahead_stop (cdu);
 		unload_image (cdu);
 		uae_sem_destroy (&cdu->sub_sem);
 	}
@@ -258,9 +258,29 @@ static int cl450_frame_width, cl450_frame_height;
 static int cl450_video_hsync_wait;
 static int cl450_videoram_read;
 static int cl450_videoram_write;
-static int cl450_videoram_cnt;
+static volatile uae_atomic cl450_videoram_cnt;
 static int cl450_frame_cnt;
 
+// MPEG decoding and YUV to RGB conversion run in their own thread.
+// Emulation side feeds bitstream chunks when decoder is idle and
+// collects decoded frames and header events in hsync handler.
+#define FMV_DECODER_DATA 1
+#define FMV_DECODER_RESET 2
+#define FMV_DECODER_QUIT 3
+#define FMV_EVENT_SEQUENCE 0
+#define FMV_EVENT_GOP 1
+static smp_comm_pipe fmv_decoder_pipe;
+static volatile int fmv_decoder_running;
+static uae_sem_t fmv_decoder_sem;
+static uae_sem_t fmv_frame_sem;
+static volatile uae_atomic fmv_frame_waiting;
+static volatile bool fmv_decoder_needdata;
+static volatile bool fmv_decoder_abort;
+static volatile uae_atomic fmv_decoder_events;
+static int fmv_seq_rate, fmv_seq_width, fmv_seq_height;
+static uae_u16 fmv_gop_timecode[2];
+static int fmv_decoder_width, fmv_decoder_height, fmv_decoder_pixbytes;
+
 static uae_u16 l64111_regs[32];
 static uae_u16 l64111intmask[2], l64111intstatus[2];
 #define L64111_CHANNEL_BUFFERS 128
@@ -796,83 +816,187 @@ static void cl450_write_dram(int addr, uae_u16 w)
 static struct zfile *videodump;
 #endif
 
-static void cl450_parse_frame(void)
+// decoder thread side, runs until all data given to libmpeg2 is consumed
+static void cl450_decode(void)
 {
 	for (;;) {
 		mpeg2_state_t mpeg_state = mpeg2_parse(mpeg_decoder);
 		switch (mpeg_state)
 		{
 			case STATE_BUFFER:
-			{
-				int bufsize = cl450_buffer_offset;
-				if (bufsize == 0)
-					return;
-				while (bufsize > 0 && cl450_newpacket_mode) {
-					struct cl450_newpacket *np = &cl450_newpacket_buffer[cl450_newpacket_offset_read];
-					if (cl450_newpacket_offset_read == cl450_newpacket_offset_write)
-						return;
-					int size = np->length > bufsize ? bufsize : np->length;
-
-					if (np->length == 0) {
-						write_log(_T("CL450 no matching newpacket!?\n"));
-						return;
-					}
-
-					np->length -= size;
-					bufsize -= size;
-					if (np->length > 0)
-						break;
-					//write_log(_T("CL450: NewPacket %d done\n"), cl450_newpacket_offset_read);
-					cl450_newpacket_offset_read++;
-					cl450_newpacket_offset_read &= CL450_NEWPACKET_BUFFER_SIZE - 1;
-				}
-#if DUMP_VIDEO
-				if (!videodump)
-					videodump = zfile_fopen(_T("c:\\temp\\1.mpg"), _T("wb"));
-				zfile_fwrite(&ram[CL450_MPEG_BUFFER], 1, cl450_buffer_offset, videodump);
-#endif
-				memcpy(&fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_BUFFER], cl450_buffer_offset);
-				mpeg2_buffer(mpeg_decoder, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset + cl450_buffer_offset);
-				libmpeg_offset += cl450_buffer_offset;
-				if (libmpeg_offset >= CL450_MPEG_DECODE_BUFFER_SIZE - CL450_MPEG_BUFFER_SIZE)
-					libmpeg_offset = 0;
-				cl450_buffer_offset = 0;
-			}
-			break;
+				return;
 			case STATE_SEQUENCE:
-				cl450_frame_pixbytes = 4;
-				mpeg2_convert(mpeg_decoder, cl450_frame_pixbytes == 2 ? mpeg2convert_rgb16 : mpeg2convert_rgb32, NULL);
-				cl450_set_status(CL_INT_SEQ_V);
-				cl450_frame_rate = mpeg_info->sequence->frame_period ? 27000000 / mpeg_info->sequence->frame_period : 0;
-				cl450_frame_width = mpeg_info->sequence->width;
-				cl450_frame_height = mpeg_info->sequence->height;
-				cl450_write_dram(CL_DRAM_PICTURE_RATE, cl450_frame_rate);
-				cl450_write_dram(CL_DRAM_H_SIZE, cl450_frame_width);
-				cl450_write_dram(CL_DRAM_V_SIZE, cl450_frame_height);
+				fmv_decoder_pixbytes = 4;
+				mpeg2_convert(mpeg_decoder, fmv_decoder_pixbytes == 2 ? mpeg2convert_rgb16 : mpeg2convert_rgb32, NULL);
+				fmv_decoder_width = mpeg_info->sequence->width;
+				fmv_decoder_height = mpeg_info->sequence->height;
+				fmv_seq_rate = mpeg_info->sequence->frame_period ? 27000000 / mpeg_info->sequence->frame_period : 0;
+				fmv_seq_width = fmv_decoder_width;
+				fmv_seq_height = fmv_decoder_height;
+				atomic_or(&fmv_decoder_events, 1 << FMV_EVENT_SEQUENCE);
 				break;
 			case STATE_PICTURE:
 				break;
 			case STATE_GOP:
-				cl450_write_dram(CL_DRAM_TIME_CODE_0, (mpeg_info->gop->hours << 6) | (mpeg_info->gop->minutes));
-				cl450_write_dram(CL_DRAM_TIME_CODE_1, (mpeg_info->gop->seconds << 6) | (mpeg_info->gop->pictures));
+				fmv_gop_timecode[0] = (mpeg_info->gop->hours << 6) | (mpeg_info->gop->minutes);
+				fmv_gop_timecode[1] = (mpeg_info->gop->seconds << 6) | (mpeg_info->gop->pictures);
+				atomic_or(&fmv_decoder_events, 1 << FMV_EVENT_GOP);
 				break;
 			case STATE_SLICE:
 			case STATE_END:
 				if (mpeg_info->display_fbuf) {
-					memcpy(videoram[cl450_videoram_write].data, mpeg_info->display_fbuf->buf[0], cl450_frame_width * cl450_frame_height * cl450_frame_pixbytes);
-					videoram[cl450_videoram_write].width = cl450_frame_width;
-					videoram[cl450_videoram_write].height = cl450_frame_height;
-					videoram[cl450_videoram_write].depth = cl450_frame_pixbytes;
+					// wait until hsync handler has displayed a frame
+					while (cl450_videoram_cnt >= CL450_VIDEO_BUFFERS - 1) {
+						if (fmv_decoder_abort)
+							return;
+						// fmv_frame_sem is only posted while this is set
+						atomic_or(&fmv_frame_waiting, 1);
+						if ((cl450_videoram_cnt < CL450_VIDEO_BUFFERS - 1 || fmv_decoder_abort) && atomic_and(&fmv_frame_waiting, 0))
+							continue;
+						uae_sem_wait(&fmv_frame_sem);
+					}
+					memcpy(videoram[cl450_videoram_write].data, mpeg_info->display_fbuf->buf[0], fmv_decoder_width * fmv_decoder_height * fmv_decoder_pixbytes);
+					videoram[cl450_videoram_write].width = fmv_decoder_width;
+					videoram[cl450_videoram_write].height = fmv_decoder_height;
+					videoram[cl450_videoram_write].depth = fmv_decoder_pixbytes;
 					cl450_videoram_write++;
 					cl450_videoram_write &= CL450_VIDEO_BUFFERS - 1;
-					cl450_videoram_cnt++;
+					atomic_inc(&cl450_videoram_cnt);
 					//write_log(_T("%d\n"), cl450_videoram_cnt);
 				}
-				return;
+				break;
 			default:
 				break;
 		}
+		if (fmv_decoder_abort)
+			return;
+	}
+}
+
+static void fmv_decoder_thread(void *v)
+{
+	fmv_decoder_running = 1;
+	for (;;) {
+		int cmd = read_comm_pipe_int_blocking(&fmv_decoder_pipe);
+		if (cmd == FMV_DECODER_QUIT) {
+			break;
+		} else if (cmd == FMV_DECODER_RESET) {
+			mpeg2_reset(mpeg_decoder, 1);
+			cl450_videoram_write = 0;
+			fmv_decoder_needdata = true;
+			uae_sem_post(&fmv_decoder_sem);
+		} else if (cmd == FMV_DECODER_DATA) {
+			int offset = read_comm_pipe_int_blocking(&fmv_decoder_pipe);
+			int len = read_comm_pipe_int_blocking(&fmv_decoder_pipe);
+			uae_u8 *p = &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + offset;
+			mpeg2_buffer(mpeg_decoder, p, p + len);
+			cl450_decode();
+			fmv_decoder_needdata = true;
+		}
+	}
+	fmv_decoder_running = 0;
+	uae_sem_post(&fmv_decoder_sem);
+}
+
+static void fmv_decoder_start(void)
+{
+	if (fmv_decoder_running)
+		return;
+	init_comm_pipe(&fmv_decoder_pipe, 30, 3);
+	uae_sem_init(&fmv_decoder_sem, 0, 0);
+	uae_sem_init(&fmv_frame_sem, 0, 0);
+	fmv_frame_waiting = 0;
+	fmv_decoder_abort = false;
+	fmv_decoder_needdata = true;
+	fmv_decoder_events = 0;
+	fmv_decoder_running = 1;
+	uae_start_thread(_T("cd32fmv"), fmv_decoder_thread, NULL, NULL);
+}
+
+// stop decoding current data and wait until decoder thread has processed cmd
+static void fmv_decoder_sync(int cmd)
+{
+	if (!fmv_decoder_running)
+		return;
+	fmv_decoder_abort = true;
+	if (atomic_and(&fmv_frame_waiting, 0))
+		uae_sem_post(&fmv_frame_sem);
+	write_comm_pipe_int(&fmv_decoder_pipe, cmd, 1);
+	uae_sem_wait(&fmv_decoder_sem);
+	fmv_decoder_abort = false;
+}
+
+static void fmv_decoder_stop(void)
+{
+	if (!fmv_decoder_running)
+		return;
+	fmv_decoder_sync(FMV_DECODER_QUIT);
+	destroy_comm_pipe(&fmv_decoder_pipe);
+	uae_sem_destroy(&fmv_decoder_sem);
+	uae_sem_destroy(&fmv_frame_sem);
+}
+
+// emulation side: apply header info decoded by the thread
+static void cl450_decoder_events(void)
+{
+	if (!fmv_decoder_events)
+		return;
+	if (atomic_bit_test_and_reset(&fmv_decoder_events, FMV_EVENT_SEQUENCE)) {
+		cl450_frame_pixbytes = 4;
+		cl450_frame_rate = fmv_seq_rate;
+		cl450_frame_width = fmv_seq_width;
+		cl450_frame_height = fmv_seq_height;
+		cl450_set_status(CL_INT_SEQ_V);
+		cl450_write_dram(CL_DRAM_PICTURE_RATE, cl450_frame_rate);
+		cl450_write_dram(CL_DRAM_H_SIZE, cl450_frame_width);
+		cl450_write_dram(CL_DRAM_V_SIZE, cl450_frame_height);
+	}
+	if (atomic_bit_test_and_reset(&fmv_decoder_events, FMV_EVENT_GOP)) {
+		cl450_write_dram(CL_DRAM_TIME_CODE_0, fmv_gop_timecode[0]);
+		cl450_write_dram(CL_DRAM_TIME_CODE_1, fmv_gop_timecode[1]);
+	}
+}
+
+// emulation side: pass buffered bitstream to idle decoder thread
+static void cl450_parse_frame(void)
+{
+	int bufsize = cl450_buffer_offset;
+
+	if (!fmv_decoder_needdata || bufsize == 0)
+		return;
+	while (bufsize > 0 && cl450_newpacket_mode) {
+		struct cl450_newpacket *np = &cl450_newpacket_buffer[cl450_newpacket_offset_read];
+		if (cl450_newpacket_offset_read == cl450_newpacket_offset_write)
+			return;
+		int size = np->length > bufsize ? bufsize : np->length;
+
+		if (np->length == 0) {
+			write_log(_T("CL450 no matching newpacket!?\n"));
+			return;
+		}
+
+		np->length -= size;
+		bufsize -= size;
+		if (np->length > 0)
+			break;
+		//write_log(_T("CL450: NewPacket %d done\n"), cl450_newpacket_offset_read);
+		cl450_newpacket_offset_read++;
+		cl450_newpacket_offset_read &= CL450_NEWPACKET_BUFFER_SIZE - 1;
 	}
+#if DUMP_VIDEO
+	if (!videodump)
+		videodump = zfile_fopen(_T("c:\\temp\\1.mpg"), _T("wb"));
+	zfile_fwrite(&ram[CL450_MPEG_BUFFER], 1, cl450_buffer_offset, videodump);
+#endif
+	memcpy(&fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_BUFFER], cl450_buffer_offset);
+	fmv_decoder_needdata = false;
+	write_comm_pipe_int(&fmv_decoder_pipe, FMV_DECODER_DATA, 0);
+	write_comm_pipe_int(&fmv_decoder_pipe, libmpeg_offset, 0);
+	write_comm_pipe_int(&fmv_decoder_pipe, cl450_buffer_offset, 1);
+	libmpeg_offset += cl450_buffer_offset;
+	if (libmpeg_offset >= CL450_MPEG_DECODE_BUFFER_SIZE - CL450_MPEG_BUFFER_SIZE)
+		libmpeg_offset = 0;
+	cl450_buffer_offset = 0;
 }
 
 static void cl450_reset(void)
@@ -889,12 +1013,16 @@ static void cl450_reset(void)
 	cl450_newpacket_mode = false;
 	cl450_newpacket_offset_write = 0;
 	cl450_newpacket_offset_read = 0;
+	if (fmv_decoder_running) {
+		fmv_decoder_sync(FMV_DECODER_RESET);
+	} else if (mpeg_decoder) {
+		mpeg2_reset(mpeg_decoder, 1);
+	}
+	fmv_decoder_events = 0;
 	cl450_videoram_write = 0;
 	cl450_videoram_read = 0;
 	cl450_videoram_cnt = 0;
 	memset(cl450_regs, 0, sizeof cl450_regs);
-	if (mpeg_decoder)
-		mpeg2_reset(mpeg_decoder, 1);
 	if (fmv_ram_bank.baseaddr) {
 		memset(fmv_ram_bank.baseaddr, 0, 0x100);
 		write_log(_T("CL450 reset\n"));
@@ -1473,7 +1601,9 @@ static void cd32_fmv_hsync_handler(void)
 				videoram[cl450_videoram_read].depth, cl450_blank ? NULL : videoram[cl450_videoram_read].data);
 			cl450_videoram_read++;
 			cl450_videoram_read &= CL450_VIDEO_BUFFERS - 1;
-			cl450_videoram_cnt--;
+			atomic_dec(&cl450_videoram_cnt);
+			if (atomic_and(&fmv_frame_waiting, 0))
+				uae_sem_post(&fmv_frame_sem);
 		}
 		cl450_video_hsync_wait = (int)max_sync_vpos;
 		while (remaining_sync_vpos >= 1.0) {
@@ -1491,6 +1621,8 @@ static void cd32_fmv_hsync_handler(void)
 	if (vpos & 7)
 		return;
 
+	cl450_decoder_events();
+
 	if (cl450_play > 0) {
 		if (cl450_newpacket_mode && cl450_buffer_offset < cl450_threshold) {
 			int newpacket_len = 0;
@@ -1530,6 +1662,7 @@ static void cd32_fmv_free(void)
 	uae_sem_destroy(&play_sem);
 	xfree(pcmaudio);
 	pcmaudio = NULL;
+	fmv_decoder_stop();
 	if (mpeg_decoder)
 		mpeg2_close(mpeg_decoder);
 	mpeg_decoder = NULL;
@@ -1576,6 +1709,7 @@ addrbank *cd32_fmv_init (struct autoconfig_info *aci)
 		mpeg_decoder = mpeg2_init();
 		mpeg_info = mpeg2_info(mpeg_decoder);
 	}
+	fmv_decoder_start();
 	memset(&cas, 0, sizeof(cas));
 	fmv_bank.mask = fmv_board_size - 1;
 	map_banks(&fmv_rom_bank, (fmv_start + ROM_BASE) >> 16, fmv_rom_size >> 16, 0);
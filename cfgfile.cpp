@@ -3050,6 +3050,8 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	cfgfile_dwrite_strarr(f, _T("scsidev_mode"), uaescsidevmodes, p->uaescsidevmode);
 #endif
 	cfgfile_dwrite_bool(f, _T("harddrive_write_protect"), p->harddrive_read_only);
+	cfgfile_dwrite(f, _T("harddrive_cache_size"), _T("%d"), p->harddrive_cache_size);
+	cfgfile_dwrite(f, _T("archive_cache_size"), _T("%d"), p->archive_cache_size);
 
 	write_inputdevice_config (p, f);
 }
@@ -3698,6 +3700,8 @@ static int cfgfile_parse_host (struct uae_prefs *p, TCHAR *option, TCHAR *value)
 		|| cfgfile_intval (option, value, _T("gfx_center_vertical_size"), &p->gfx_ycenter_size, 1)
 
 		|| cfgfile_intval (option, value, _T("filesys_max_size"), &p->filesys_limit, 1)
+		|| cfgfile_intval (option, value, _T("harddrive_cache_size"), &p->harddrive_cache_size, 1)
+		|| cfgfile_intval (option, value, _T("archive_cache_size"), &p->archive_cache_size, 1)
 		|| cfgfile_intval (option, value, _T("filesys_max_name_length"), &p->filesys_max_name, 1)
 		|| cfgfile_intval (option, value, _T("filesys_max_file_size"), &p->filesys_max_file_size, 1)
 		|| cfgfile_yesno (option, value, _T("filesys_inject_icons"), &p->filesys_inject_icons)
@@ -8685,6 +8689,8 @@ void default_prefs (struct uae_prefs *p, bool reset, int type)
 	p->filesys_limit = 0;
 	p->filesys_max_name = 107;
 	p->filesys_max_file_size = 0x7fffffff;
+	p->harddrive_cache_size = 0;
+	p->archive_cache_size = 0;
 
 	p->z3autoconfig_start = 0x10000000;
 	p->chipmem.size = 0x00080000;
@@ -26,6 +26,7 @@ int disk_debug_track = -1;
 
 #include "uae.h"
 #include "options.h"
+#include "threaddep/thread.h"
 #include "memory.h"
 #include "events.h"
 #include "custom.h"
@@ -54,6 +55,7 @@ int disk_debug_track = -1;
 #include "scp.h"
 #endif
 #include "crc32.h"
+#include "diskutil.h"
 #include "inputrecord.h"
 #ifdef AMAX
 #include "amax.h"
@@ -763,8 +765,11 @@ static void drive_settype_id (drive *drv)
 #endif
 }
 
+static void trackcache_reset(drive *drv);
+
 static void drive_image_free (drive *drv)
 {
+	trackcache_reset(drv);
 	switch (drv->filetype)
 	{
 	case ADF_IPF:
@@ -987,7 +992,7 @@ int DISK_validate_filename (struct uae_prefs *p, const TCHAR *fname_in, int num,
 		if (!f) {
 			if (wrprot)
 				*wrprot = 1;
-			f = zfile_fopen (outname, _T("rb"), ZFD_NORMAL | ZFD_DISKHISTORY);
+			f = zfile_fopen (outname, _T("rb"), ZFD_NORMAL | ZFD_DISKHISTORY | ZFD_MMAP);
 		}
 		if (f && crc32)
 			*crc32 = zfile_crc32 (f);
@@ -2023,7 +2028,22 @@ static void drive_motor (drive * drv, bool off)
 #endif
 }
 
-static void read_floppy_data(struct zfile *diskfile, int type, trackid *tid, int sector, uae_u8 *dst, uae_u8 *secheaddst, int len)
+// prefetchok != NULL: called from the track prefetch thread, only direct memory access is allowed
+static void read_floppy_image(struct zfile *diskfile, uae_s64 offset, uae_u8 *dst, int len, bool *prefetchok)
+{
+	if (prefetchok) {
+		const uae_u8 *p = zfile_get_data_range(diskfile, offset, len);
+		if (p)
+			memcpy(dst, p, len);
+		else
+			*prefetchok = false;
+		return;
+	}
+	zfile_fseek(diskfile, offset, SEEK_SET);
+	zfile_fread(dst, 1, len, diskfile);
+}
+
+static void read_floppy_data(struct zfile *diskfile, int type, trackid *tid, int sector, uae_u8 *dst, uae_u8 *secheaddst, int len, bool *prefetchok)
 {
 	if (len <= 0)
 		return;
@@ -2050,25 +2070,9 @@ static void read_floppy_data(struct zfile *diskfile, int type, trackid *tid, int
 	if (tid->offs < 0 || sector < 0)
 		return;
 	if (type == ADF_NORMAL_HEADER && tid->extraoffs > 0) {
-		zfile_fseek(diskfile, tid->extraoffs + sector * 16, SEEK_SET);
-		zfile_fread(secheaddst, 1, 16, diskfile);
-	}
-	zfile_fseek(diskfile, tid->offs + sector * 512, SEEK_SET);
-	zfile_fread(dst, 1, len, diskfile);
-}
-
-/* Megalomania does not like zero MFM words... */
-static void mfmcode (uae_u16 * mfm, int words)
-{
-	uae_u32 lastword = 0;
-	while (words--) {
-		uae_u32 v = (*mfm) & 0x55555555;
-		uae_u32 lv = (lastword << 16) | v;
-		uae_u32 nlv = 0x55555555 & ~lv;
-		uae_u32 mfmbits = (nlv << 1) & (nlv >> 1);
-		*mfm++ = v | mfmbits;
-		lastword = v;
+		read_floppy_image(diskfile, tid->extraoffs + sector * 16, secheaddst, 16, prefetchok);
 	}
+	read_floppy_image(diskfile, tid->offs + sector * 512, dst, len, prefetchok);
 }
 
 static const uae_u8 mfmencodetable[16] = {
@@ -2101,17 +2105,16 @@ static uae_u16 *mfmcoder (uae_u8 *src, uae_u16 *dest, int len)
 	return dest;
 }
 
-static void decode_pcdos (drive *drv, int tside)
+static void decode_pcdos (drive *drv, int tr, uae_u16 *mfmbuf, int *tracklenp, int *skipoffsetp, bool *prefetchok)
 {
 	int i, len;
-	int tr = drv->cyl * 2 + tside;
 	uae_u16 *dstmfmbuf, *mfm2;
 	uae_u8 secbuf[1000];
 	uae_u16 crc16;
 	trackid *ti = drv->trackdata + tr;
 	int tracklen = 12500;
 
-	mfm2 = drv->bigmfmbuf;
+	mfm2 = mfmbuf;
 	*mfm2++ = 0x9254;
 	memset (secbuf, 0x4e, 40);
 	memset (secbuf + 40, 0x00, 12);
@@ -2131,8 +2134,8 @@ static void decode_pcdos (drive *drv, int tside)
 		secbuf[13] = 0xa1;
 		secbuf[14] = 0xa1;
 		secbuf[15] = 0xfe;
-		secbuf[16] = drv->cyl;
-		secbuf[17] = side;
+		secbuf[16] = tr >> 1;
+		secbuf[17] = tr & 1;
 		secbuf[18] = 1 + i;
 		secbuf[19] = 2; // 128 << 2 = 512
 		crc16 = get_crc16(secbuf + 12, 3 + 1 + 4);
@@ -2144,7 +2147,7 @@ static void decode_pcdos (drive *drv, int tside)
 		secbuf[57] = 0xa1;
 		secbuf[58] = 0xa1;
 		secbuf[59] = 0xfb;
-		read_floppy_data (drv->diskfile, drv->filetype, ti, i, &secbuf[60], NULL, 512);
+		read_floppy_data (drv->diskfile, drv->filetype, ti, i, &secbuf[60], NULL, 512, prefetchok);
 		crc16 = get_crc16 (secbuf + 56, 3 + 1 + 512);
 		secbuf[60 + 512] = crc16 >> 8;
 		secbuf[61 + 512] = crc16 & 0xff;
@@ -2159,29 +2162,27 @@ static void decode_pcdos (drive *drv, int tside)
 		mfm2[57] = 0x4489;
 		mfm2[58] = 0x4489;
 	}
-	while (dstmfmbuf - drv->bigmfmbuf < tracklen / 2)
+	while (dstmfmbuf - mfmbuf < tracklen / 2)
 		*dstmfmbuf++ = 0x9254;
-	drv->skipoffset = 0;
-	drv->tracklen = addrdiff(dstmfmbuf, drv->bigmfmbuf) * 16;
+	*skipoffsetp = 0;
+	*tracklenp = addrdiff(dstmfmbuf, mfmbuf) * 16;
 	if (disk_debug_logging > 0)
 		write_log (_T("pcdos read track %d\n"), tr);
 }
 
-static void decode_amigados(drive *drv, int tside)
+static void decode_amigados(drive *drv, int tr, uae_u16 *dstmfmbuf, int *tracklenp, int *skipoffsetp, bool *prefetchok)
 {
 	/* Normal AmigaDOS format track */
-	int tr = drv->cyl * 2 + tside;
 	int sec;
 	int dstmfmoffset = 0;
-	uae_u16 *dstmfmbuf = drv->bigmfmbuf;
 	int len = drv->num_secs * 544 + FLOPPY_GAP_LEN;
 	int prevbit;
 
 	trackid *ti = drv->trackdata + tr;
 	memset (dstmfmbuf, 0xaa, len * 2);
 	dstmfmoffset += FLOPPY_GAP_LEN;
-	drv->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
-	drv->tracklen = len * 2 * 8;
+	*skipoffsetp = (FLOPPY_GAP_LEN * 8) / 3 * 2;
+	*tracklenp = len * 2 * 8;
 
 	prevbit = 0;
 	for (sec = 0; sec < drv->num_secs; sec++) {
@@ -2202,7 +2203,7 @@ static void decode_amigados(drive *drv, int tside)
 		for (i = 8; i < 24; i++)
 			secbuf[i] = 0;
 
-		read_floppy_data (drv->diskfile, drv->filetype, ti, sec, &secbuf[32], secheadbuf, 512);
+		read_floppy_data (drv->diskfile, drv->filetype, ti, sec, &secbuf[32], secheadbuf, 512, prefetchok);
 
 		mfmbuf[0] = prevbit ? 0x2aaa : 0xaaaa;
 		mfmbuf[1] = 0xaaaa;
@@ -2240,17 +2241,7 @@ static void decode_amigados(drive *drv, int tside)
 		mfmbuf[26] = deven >> 16;
 		mfmbuf[27] = deven;
 
-		for (i = 0; i < 512; i += 4) {
-			deven = ((secbuf[i + 32] << 24) | (secbuf[i + 33] << 16)
-				| (secbuf[i + 34] << 8) | (secbuf[i + 35]));
-			dodd = deven >> 1;
-			deven &= 0x55555555;
-			dodd &= 0x55555555;
-			mfmbuf[(i >> 1) + 32] = dodd >> 16;
-			mfmbuf[(i >> 1) + 33] = dodd;
-			mfmbuf[(i >> 1) + 256 + 32] = deven >> 16;
-			mfmbuf[(i >> 1) + 256 + 33] = deven;
-		}
+		mfm_encode_block (&secbuf[32], mfmbuf + 32, 256);
 		for (i = 32; i < 544; i += 2) {
 			dck ^= (mfmbuf[i] << 16) | mfmbuf[i + 1];
 		}
@@ -2263,7 +2254,7 @@ static void decode_amigados(drive *drv, int tside)
 
 		mfmbuf[544] = 0;
 
-		mfmcode (mfmbuf + 4, 544 - 4 + 1);
+		mfm_clockbits (mfmbuf + 4, 544 - 4 + 1);
 
 		for (i = 0; i < 544; i++) {
 			dstmfmbuf[dstmfmoffset % len] = mfmbuf[i];
@@ -2289,20 +2280,18 @@ static void decode_amigados(drive *drv, int tside)
 *
 */
 
-static void decode_diskspare(drive *drv, int tside)
+static void decode_diskspare(drive *drv, int tr, uae_u16 *dstmfmbuf, int *tracklenp, int *skipoffsetp, bool *prefetchok)
 {
-	int tr = drv->cyl * 2 + tside;
 	int sec;
 	int dstmfmoffset = 0;
 	int size = 512 + 8;
-	uae_u16 *dstmfmbuf = drv->bigmfmbuf;
 	int len = drv->num_secs * size + FLOPPY_GAP_LEN;
 
 	trackid *ti = drv->trackdata + tr;
 	memset (dstmfmbuf, 0xaa, len * 2);
 	dstmfmoffset += FLOPPY_GAP_LEN;
-	drv->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
-	drv->tracklen = len * 2 * 8;
+	*skipoffsetp = (FLOPPY_GAP_LEN * 8) / 3 * 2;
+	*tracklenp = len * 2 * 8;
 
 	for (sec = 0; sec < drv->num_secs; sec++) {
 		uae_u8 secbuf[512 + 8];
@@ -2316,7 +2305,7 @@ static void decode_diskspare(drive *drv, int tside)
 		secbuf[2] = 0;
 		secbuf[3] = 0;
 
-		read_floppy_data (drv->diskfile, drv->filetype, ti, sec, &secbuf[4], NULL, 512);
+		read_floppy_data (drv->diskfile, drv->filetype, ti, sec, &secbuf[4], NULL, 512, prefetchok);
 
 		mfmbuf[0] = 0xaaaa;
 		mfmbuf[1] = 0x4489;
@@ -2334,7 +2323,7 @@ static void decode_diskspare(drive *drv, int tside)
 			mfmbuf[i + 8 + 2] = deven >> 16;
 			mfmbuf[i + 8 + 3] = deven;
 		}
-		mfmcode (mfmbuf + 8, 512);
+		mfm_clockbits (mfmbuf + 8, 512);
 
 		i = 8;
 		chk = mfmbuf[i++] & 0x7fff;
@@ -2353,7 +2342,7 @@ static void decode_diskspare(drive *drv, int tside)
 		mfmbuf[5] = dodd;
 		mfmbuf[6] = deven >> 16;
 		mfmbuf[7] = deven;
-		mfmcode (mfmbuf + 4, 4);
+		mfm_clockbits (mfmbuf + 4, 4);
 
 		for (i = 0; i < 512 + 8; i++) {
 			dstmfmbuf[dstmfmoffset % len] = mfmbuf[i];
@@ -2365,6 +2354,234 @@ static void decode_diskspare(drive *drv, int tside)
 		write_log (_T("diskspare read track %d\n"), tr);
 }
 
+/*
+* Decoded track cache for sector based images (ADF, extended ADF, PC)
+*
+* Tracks are kept MFM encoded, neighbouring cylinders are decoded in the
+* background when the whole image is directly addressable in memory.
+*
+*/
+
+#define TRACKCACHE_ENTRIES 8
+#define TRACKCACHE_PREFETCH 6
+
+struct trackcacheentry
+{
+	int track;
+	int tracklen;
+	int skipoffset;
+	uae_u32 lastuse;
+	uae_u16 *mfm;
+};
+
+struct trackcache
+{
+	struct trackcacheentry entries[TRACKCACHE_ENTRIES];
+	uae_sem_t lock;
+	uae_u32 tick;
+	int prefetch;
+	int pending[TRACKCACHE_PREFETCH];
+	int pendingcnt, pendingpos;
+};
+
+static struct trackcache trackcaches[MAX_FLOPPY_DRIVES];
+static volatile int trackcache_thread_state;
+static uae_sem_t trackcache_wake;
+
+static bool trackcache_decodable(trackid *ti)
+{
+	return ti->type == TRACK_PCDOS || ti->type == TRACK_AMIGADOS || ti->type == TRACK_DISKSPARE;
+}
+
+static void trackcache_decode(drive *drv, int tr, uae_u16 *mfm, int *tracklen, int *skipoffset, bool *prefetchok)
+{
+	trackid *ti = drv->trackdata + tr;
+	if (ti->type == TRACK_PCDOS)
+		decode_pcdos(drv, tr, mfm, tracklen, skipoffset, prefetchok);
+	else if (ti->type == TRACK_AMIGADOS)
+		decode_amigados(drv, tr, mfm, tracklen, skipoffset, prefetchok);
+	else
+		decode_diskspare(drv, tr, mfm, tracklen, skipoffset, prefetchok);
+}
+
+static struct trackcacheentry *trackcache_find(struct trackcache *tc, int tr)
+{
+	for (int i = 0; i < TRACKCACHE_ENTRIES; i++) {
+		struct trackcacheentry *e = &tc->entries[i];
+		if (e->mfm && e->track == tr)
+			return e;
+	}
+	return NULL;
+}
+
+static struct trackcacheentry *trackcache_alloc(struct trackcache *tc, int tr)
+{
+	struct trackcacheentry *e = NULL;
+	for (int i = 0; i < TRACKCACHE_ENTRIES; i++) {
+		struct trackcacheentry *e2 = &tc->entries[i];
+		if (!e2->mfm || e2->track < 0) {
+			e = e2;
+			break;
+		}
+		if (!e || e2->lastuse < e->lastuse)
+			e = e2;
+	}
+	if (!e->mfm) {
+		e->mfm = xmalloc(uae_u16, MAXMFMBUF);
+		if (!e->mfm)
+			return NULL;
+	}
+	e->track = tr;
+	e->lastuse = ++tc->tick;
+	return e;
+}
+
+static void trackcache_thread(void *v)
+{
+	while (trackcache_thread_state > 0) {
+		bool busy = false;
+		for (int dr = 0; dr < MAX_FLOPPY_DRIVES; dr++) {
+			struct trackcache *tc = &trackcaches[dr];
+			drive *drv = &floppy[dr];
+			uae_sem_wait(&tc->lock);
+			if (tc->pendingpos < tc->pendingcnt) {
+				int tr = tc->pending[tc->pendingpos++];
+				if (!trackcache_find(tc, tr)) {
+					struct trackcacheentry *e = trackcache_alloc(tc, tr);
+					if (e) {
+						bool ok = true;
+						trackcache_decode(drv, tr, e->mfm, &e->tracklen, &e->skipoffset, &ok);
+						if (!ok) {
+							// image is not in memory after all, let the main thread decode it
+							e->track = -1;
+							tc->prefetch = 0;
+							tc->pendingcnt = tc->pendingpos = 0;
+						}
+					}
+				}
+				busy = true;
+			}
+			uae_sem_post(&tc->lock);
+		}
+		if (!busy)
+			uae_sem_wait(&trackcache_wake);
+	}
+	trackcache_thread_state = 0;
+}
+
+// queue current and neighbouring cylinders, other side of current cylinder first
+static void trackcache_prefetch(drive *drv, struct trackcache *tc, int tr)
+{
+	static const int cyloffsets[] = { 0, 1, -1 };
+	int cyl = tr >> 1;
+
+	if (tc->prefetch < 0) {
+		uae_s64 size = zfile_size(drv->diskfile);
+		tc->prefetch = size > 0 && zfile_get_data_range(drv->diskfile, 0, size) != NULL;
+	}
+	tc->pendingcnt = tc->pendingpos = 0;
+	if (!tc->prefetch)
+		return;
+	for (int i = 0; i < (int)(sizeof cyloffsets / sizeof cyloffsets[0]); i++) {
+		for (int j = 0; j < 2; j++) {
+			int ptr = (cyl + cyloffsets[i]) * 2 + ((tr & 1) ^ (i == 0 ? 1 - j : j));
+			struct trackcacheentry *e;
+			if (ptr == tr || ptr < 0 || ptr >= drv->num_tracks)
+				continue;
+			if (!trackcache_decodable(drv->trackdata + ptr))
+				continue;
+			if (drv->writediskfile && drv->writetrackdata[ptr].bitlen > 0)
+				continue;
+			e = trackcache_find(tc, ptr);
+			if (e) {
+				e->lastuse = ++tc->tick;
+				continue;
+			}
+			tc->pending[tc->pendingcnt++] = ptr;
+		}
+	}
+	if (!tc->pendingcnt)
+		return;
+	if (!trackcache_thread_state) {
+		uae_sem_init(&trackcache_wake, 0, 0);
+		trackcache_thread_state = 1;
+		uae_start_thread(_T("floppy_prefetch"), trackcache_thread, NULL, NULL);
+	}
+	uae_sem_post(&trackcache_wake);
+}
+
+static void trackcache_load(drive *drv, int tr)
+{
+	struct trackcache *tc = &trackcaches[drv->drvnum];
+	struct trackcacheentry *e;
+
+	uae_sem_wait(&tc->lock);
+	e = trackcache_find(tc, tr);
+	if (e) {
+		memcpy(drv->bigmfmbuf, e->mfm, (e->tracklen + 15) / 16 * sizeof(uae_u16));
+		drv->tracklen = e->tracklen;
+		drv->skipoffset = e->skipoffset;
+		e->lastuse = ++tc->tick;
+	} else {
+		trackcache_decode(drv, tr, drv->bigmfmbuf, &drv->tracklen, &drv->skipoffset, NULL);
+		e = trackcache_alloc(tc, tr);
+		if (e) {
+			memcpy(e->mfm, drv->bigmfmbuf, (drv->tracklen + 15) / 16 * sizeof(uae_u16));
+			e->tracklen = drv->tracklen;
+			e->skipoffset = drv->skipoffset;
+		}
+	}
+	trackcache_prefetch(drv, tc, tr);
+	uae_sem_post(&tc->lock);
+}
+
+// must be called before image or track layout changes
+static void trackcache_reset(drive *drv)
+{
+	struct trackcache *tc = &trackcaches[drv->drvnum];
+
+	if (!tc->lock)
+		return;
+	uae_sem_wait(&tc->lock);
+	for (int i = 0; i < TRACKCACHE_ENTRIES; i++)
+		tc->entries[i].track = -1;
+	tc->pendingcnt = tc->pendingpos = 0;
+	tc->prefetch = -1;
+	uae_sem_post(&tc->lock);
+}
+
+static void trackcache_init(void)
+{
+	for (int dr = 0; dr < MAX_FLOPPY_DRIVES; dr++) {
+		struct trackcache *tc = &trackcaches[dr];
+		for (int i = 0; i < TRACKCACHE_ENTRIES; i++)
+			tc->entries[i].track = -1;
+		tc->prefetch = -1;
+		uae_sem_init(&tc->lock, 0, 1);
+	}
+}
+
+static void trackcache_free(void)
+{
+	if (trackcache_thread_state) {
+		trackcache_thread_state = -1;
+		uae_sem_post(&trackcache_wake);
+		while (trackcache_thread_state)
+			sleep_millis(1);
+		uae_sem_destroy(&trackcache_wake);
+	}
+	for (int dr = 0; dr < MAX_FLOPPY_DRIVES; dr++) {
+		struct trackcache *tc = &trackcaches[dr];
+		for (int i = 0; i < TRACKCACHE_ENTRIES; i++) {
+			xfree(tc->entries[i].mfm);
+			tc->entries[i].mfm = NULL;
+			tc->entries[i].track = -1;
+		}
+		if (tc->lock)
+			uae_sem_destroy(&tc->lock);
+	}
+}
+
 static void drive_fill_bigbuf(drive *drv, int tside, int force)
 {
 	int tr = drv->cyl * 2 + tside;
@@ -2403,7 +2620,7 @@ static void drive_fill_bigbuf(drive *drv, int tside, int force)
 		trackid *wti = &drv->writetrackdata[tr];
 		drv->tracklen = wti->bitlen;
 		drv->revolutions = wti->revolutions;
-		read_floppy_data(drv->writediskfile, drv->filetype, wti, 0, (uae_u8 *)drv->bigmfmbuf, NULL, (wti->bitlen + 7) / 8);
+		read_floppy_data(drv->writediskfile, drv->filetype, wti, 0, (uae_u8 *)drv->bigmfmbuf, NULL, (wti->bitlen + 7) / 8, NULL);
 		for (i = 0; i < (drv->tracklen + 15) / 16; i++) {
 			uae_u16 *mfm = drv->bigmfmbuf + i;
 			uae_u8 *data = (uae_u8 *)mfm;
@@ -2454,17 +2671,9 @@ static void drive_fill_bigbuf(drive *drv, int tside, int force)
 		fdi2raw_loadtrack(drv->fdi, drv->bigmfmbuf, drv->tracktiming, tr, &drv->tracklen, &drv->indexoffset, &drv->multi_revolution, 1);
 #endif
 
-	} else if (ti->type == TRACK_PCDOS) {
-
-		decode_pcdos(drv, tside);
-
-	} else if (ti->type == TRACK_AMIGADOS) {
+	} else if (ti->type == TRACK_PCDOS || ti->type == TRACK_AMIGADOS || ti->type == TRACK_DISKSPARE) {
 
-		decode_amigados(drv, tside);
-
-	} else if (ti->type == TRACK_DISKSPARE) {
-
-		decode_diskspare(drv, tside);
+		trackcache_load(drv, tr);
 
 	} else if (ti->type == TRACK_NONE) {
 
@@ -2475,7 +2684,7 @@ static void drive_fill_bigbuf(drive *drv, int tside, int force)
 		int base_offset = ti->type == TRACK_RAW ? 0 : 1;
 		drv->tracklen = ti->bitlen + 16 * base_offset;
 		drv->bigmfmbuf[0] = ti->sync;
-		read_floppy_data (drv->diskfile, drv->filetype, ti, 0, (uae_u8*)(drv->bigmfmbuf + base_offset), NULL, (ti->bitlen + 7) / 8);
+		read_floppy_data (drv->diskfile, drv->filetype, ti, 0, (uae_u8*)(drv->bigmfmbuf + base_offset), NULL, (ti->bitlen + 7) / 8, NULL);
 		for (i = base_offset; i < (drv->tracklen + 15) / 16; i++) {
 			uae_u16 *mfm = drv->bigmfmbuf + i;
 			uae_u8 *data = (uae_u8 *) mfm;
@@ -2651,17 +2860,8 @@ static int decode_buffer(drive *drv, uae_u16 *mbuf, int cyl, int drvsec, int ddh
 		mbuf += 4;
 		chksum = (odd << 1) | even;
 		secdata = secbuf + 32;
-		for (i = 0; i < 128; i++) {
-			odd = getmfmlong (mbuf, shift);
-			even = getmfmlong (mbuf + 256, shift);
-			mbuf += 2;
-			dlong = (odd << 1) | even;
-			*secdata++ = dlong >> 24;
-			*secdata++ = dlong >> 16;
-			*secdata++ = dlong >> 8;
-			*secdata++ = dlong;
-			chksum ^= odd ^ even;
-		}
+		chksum ^= mfm_decode_block (mbuf, shift, secdata, 256);
+		mbuf += 256;
 		if (chksum) {
 			write_log (_T("Disk decode: track %d, sector %d, data checksum error\n"), cyl * 2 + side, trackoffs);
 			if (filetype == ADF_EXT2)
@@ -2693,19 +2893,14 @@ static int decode_buffer(drive *drv, uae_u16 *mbuf, int cyl, int drvsec, int ddh
 
 static uae_u8 mfmdecode (uae_u16 **mfmp, int shift)
 {
-	uae_u16 mfm = getmfmword (*mfmp, shift);
-	uae_u8 out = 0;
-	int i;
+	uae_u16 mfm = getmfmword (*mfmp, shift) & 0x5555;
 
 	(*mfmp)++;
-	mfm &= 0x5555;
-	for (i = 0; i < 8; i++) {
-		out >>= 1;
-		if (mfm & 1)
-			out |= 0x80;
-		mfm >>= 2;
-	}
-	return out;
+	// compact data bits
+	mfm = (mfm | (mfm >> 1)) & 0x3333;
+	mfm = (mfm | (mfm >> 2)) & 0x0f0f;
+	mfm = (mfm | (mfm >> 4)) & 0x00ff;
+	return (uae_u8)mfm;
 }
 
 static int drive_write_pcdos (drive *drv, struct zfile *zf, bool count)
@@ -2919,6 +3114,7 @@ static void drive_write_data (drive * drv)
 	int ret = -1;
 	int tr = drv->cyl * 2 + side;
 
+	trackcache_reset(drv);
 	if (drive_writeprotected (drv) || drv->trackdata[tr].type == TRACK_NONE) {
 		/* read original track back because we didn't really write anything */
 		drv->buffered_side = 2;
@@ -5214,6 +5410,7 @@ void DISK_free(void)
 		drive *drv = &floppy[dr];
 		drive_image_free(drv);
 	}
+	trackcache_free();
 }
 
 #ifdef FLOPPYBRIDGE
@@ -5454,6 +5651,7 @@ void floppybridge_modified(int num)
 
 void DISK_init (void)
 {
+	trackcache_init();
 	for (int dr = MAX_FLOPPY_DRIVES - 1; dr >= 0; dr--) {
 		drive *drv = &floppy[dr];
 		drv->drvnum = dr;
@@ -4,12 +4,120 @@
 #include "crc32.h"
 #include "diskutil.h"
 
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define MFM_SSE2 1
+#endif
+
 #define MFMMASK 0x55555555
 static uae_u32 getmfmlong (uae_u16 * mbuf)
 {
 	return (uae_u32)(((*mbuf << 16) | *(mbuf + 1)) & MFMMASK);
 }
 
+/* Amiga odd/even block: words odd MFM words followed by words even MFM words,
+ * starting shift bits into mbuf. Returns the xor checksum of the data bits.
+ */
+uae_u32 mfm_decode_block (const uae_u16 *mbuf, int shift, uae_u8 *dst, int words)
+{
+	uae_u16 chkhi = 0, chklo = 0;
+	int i = 0;
+
+#if MFM_SSE2
+	const __m128i mask = _mm_set1_epi16 (0x5555);
+	const __m128i sl = _mm_cvtsi32_si128 (shift);
+	const __m128i sr = _mm_cvtsi32_si128 (16 - shift);
+	__m128i acc = _mm_setzero_si128 ();
+	for (; i + 8 <= words; i += 8) {
+		const __m128i *po = (const __m128i*)(mbuf + i);
+		const __m128i *pe = (const __m128i*)(mbuf + words + i);
+		__m128i odd = _mm_or_si128 (_mm_sll_epi16 (_mm_loadu_si128 (po), sl), _mm_srl_epi16 (_mm_loadu_si128 ((const __m128i*)((const uae_u16*)po + 1)), sr));
+		__m128i even = _mm_or_si128 (_mm_sll_epi16 (_mm_loadu_si128 (pe), sl), _mm_srl_epi16 (_mm_loadu_si128 ((const __m128i*)((const uae_u16*)pe + 1)), sr));
+		odd = _mm_and_si128 (odd, mask);
+		even = _mm_and_si128 (even, mask);
+		acc = _mm_xor_si128 (acc, _mm_xor_si128 (odd, even));
+		__m128i d = _mm_or_si128 (_mm_slli_epi16 (odd, 1), even);
+		// big endian output
+		d = _mm_or_si128 (_mm_slli_epi16 (d, 8), _mm_srli_epi16 (d, 8));
+		_mm_storeu_si128 ((__m128i*)(dst + i * 2), d);
+	}
+	uae_u16 tmp[8];
+	_mm_storeu_si128 ((__m128i*)tmp, acc);
+	chkhi = tmp[0] ^ tmp[2] ^ tmp[4] ^ tmp[6];
+	chklo = tmp[1] ^ tmp[3] ^ tmp[5] ^ tmp[7];
+#endif
+	for (; i < words; i++) {
+		uae_u16 odd = ((mbuf[i] << shift) | (mbuf[i + 1] >> (16 - shift))) & 0x5555;
+		uae_u16 even = ((mbuf[words + i] << shift) | (mbuf[words + i + 1] >> (16 - shift))) & 0x5555;
+		uae_u16 d = (odd << 1) | even;
+		if (i & 1)
+			chklo ^= odd ^ even;
+		else
+			chkhi ^= odd ^ even;
+		dst[i * 2 + 0] = (uae_u8)(d >> 8);
+		dst[i * 2 + 1] = (uae_u8)d;
+	}
+	return (chkhi << 16) | chklo;
+}
+
+/* Split big endian data into odd bits block followed by even bits block, no clock bits */
+void mfm_encode_block (const uae_u8 *src, uae_u16 *dst, int words)
+{
+	int i = 0;
+
+#if MFM_SSE2
+	const __m128i mask = _mm_set1_epi16 (0x5555);
+	for (; i + 8 <= words; i += 8) {
+		__m128i d = _mm_loadu_si128 ((const __m128i*)(src + i * 2));
+		d = _mm_or_si128 (_mm_slli_epi16 (d, 8), _mm_srli_epi16 (d, 8));
+		_mm_storeu_si128 ((__m128i*)(dst + i), _mm_and_si128 (_mm_srli_epi16 (d, 1), mask));
+		_mm_storeu_si128 ((__m128i*)(dst + words + i), _mm_and_si128 (d, mask));
+	}
+#endif
+	for (; i < words; i++) {
+		uae_u16 d = (src[i * 2] << 8) | src[i * 2 + 1];
+		dst[i] = (d >> 1) & 0x5555;
+		dst[words + i] = d & 0x5555;
+	}
+}
+
+/* Insert clock bits, first word is assumed to follow a zero data bit.
+ * Megalomania does not like zero MFM words...
+ */
+void mfm_clockbits (uae_u16 *mfm, int words)
+{
+	uae_u16 last = 0;
+	int i = 0;
+
+#if MFM_SSE2
+	if (words >= 9) {
+		const __m128i mask = _mm_set1_epi16 (0x5555);
+		// first word scalar so that vector loop can always look one word back
+		uae_u16 v0 = mfm[0] & 0x5555;
+		uae_u16 n0 = 0x5555 & ~v0;
+		mfm[0] = v0 | ((n0 << 1) & ((n0 >> 1) | 0x8000));
+		for (i = 1; i + 8 <= words; i += 8) {
+			// data bits of previously written words are unchanged
+			__m128i v = _mm_and_si128 (_mm_loadu_si128 ((__m128i*)(mfm + i)), mask);
+			__m128i p = _mm_and_si128 (_mm_loadu_si128 ((__m128i*)(mfm + i - 1)), mask);
+			__m128i n = _mm_andnot_si128 (v, mask);
+			__m128i np = _mm_slli_epi16 (_mm_andnot_si128 (p, mask), 15);
+			__m128i bits = _mm_and_si128 (_mm_slli_epi16 (n, 1), _mm_or_si128 (_mm_srli_epi16 (n, 1), np));
+			_mm_storeu_si128 ((__m128i*)(mfm + i), _mm_or_si128 (v, bits));
+		}
+		last = mfm[i - 1] & 0x5555;
+	}
+#endif
+	for (; i < words; i++) {
+		uae_u32 v = mfm[i] & 0x55555555;
+		uae_u32 lv = (last << 16) | v;
+		uae_u32 nlv = 0x55555555 & ~lv;
+		uae_u32 mfmbits = (nlv << 1) & (nlv >> 1);
+		mfm[i] = v | mfmbits;
+		last = v;
+	}
+}
+
 #define FLOPPY_WRITE_LEN 6250
 
 static int drive_write_adf_amigados (uae_u16 *mbuf, uae_u16 *mend, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsize)
@@ -78,18 +186,8 @@ static int drive_write_adf_amigados (uae_u16 *mbuf, uae_u16 *mend, uae_u8 *write
 		mbuf += 4;
 		chksum = (odd << 1) | even;
 		secdata = secbuf + 32;
-		for (i = 0; i < 128; i++) {
-			odd = getmfmlong (mbuf);
-			even = getmfmlong (mbuf + 256);
-			mbuf += 2;
-			dlong = (odd << 1) | even;
-			*secdata++ = (uae_u8)(dlong >> 24);
-			*secdata++ = (uae_u8)(dlong >> 16);
-			*secdata++ = (uae_u8)(dlong >> 8);
-			*secdata++ = (uae_u8)dlong;
-			chksum ^= odd ^ even;
-		}
-		mbuf += 256;
+		chksum ^= mfm_decode_block (mbuf, 0, secdata, 256);
+		mbuf += 512;
 		if (chksum) {
 			write_log (_T("* track %d, sector %d data crc error\n"), track, trackoffs);
 			goto next;
@@ -142,19 +240,14 @@ static uae_u16 getmfmword (uae_u16 *mbuf, int shift)
 }
 static uae_u8 mfmdecode (uae_u16 **mfmp, int shift)
 {
-	uae_u16 mfm = getmfmword (*mfmp, shift);
-	uae_u8 out = 0;
-	int i;
+	uae_u16 mfm = getmfmword (*mfmp, shift) & 0x5555;
 
 	(*mfmp)++;
-	mfm &= 0x5555;
-	for (i = 0; i < 8; i++) {
-		out >>= 1;
-		if (mfm & 1)
-			out |= 0x80;
-		mfm >>= 2;
-	}
-	return out;
+	// compact data bits
+	mfm = (mfm | (mfm >> 1)) & 0x3333;
+	mfm = (mfm | (mfm >> 2)) & 0x0f0f;
+	mfm = (mfm | (mfm >> 4)) & 0x00ff;
+	return (uae_u8)mfm;
 }
 
 static int drive_write_adf_pc (uae_u16 *mbuf, uae_u16 *mend, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsecs)
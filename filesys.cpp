@@ -232,6 +232,10 @@ typedef struct {
 	smp_comm_pipe *volatile unit_pipe, *volatile back_pipe;
 	uae_thread_id tid;
 	struct _unit *self;
+	/* read/write worker pool */
+	struct fs_worker *workers;
+	uae_sem_t job_sem;
+	uae_sem_t reply_sem;
 	/* Reset handling */
 	uae_sem_t reset_sync_sem;
 	volatile int reset_state;
@@ -428,6 +432,7 @@ typedef struct key {
 	int createmode;
 	int notifyactive;
 	struct lockrecord *record;
+	volatile int busy; /* packet in progress on a worker */
 } Key;
 
 typedef struct notify {
@@ -450,7 +455,8 @@ typedef struct exallkey {
 
 #define EXKEYS 128
 #define EXALLKEYS 100
-#define MAX_AINO_HASH 128
+#define AINO_HASH_MIN 256
+#define CHILD_HASH_MIN 32
 #define NOTIFY_HASH_SIZE 127
 
 /* handler state info */
@@ -492,9 +498,13 @@ typedef struct _unit {
 
 	a_inode rootnode;
 	unsigned int aino_cache_size;
-	a_inode *aino_hash[MAX_AINO_HASH];
+	a_inode **aino_hash;
+	unsigned int aino_hash_size;
+	unsigned int aino_count;
 	unsigned int nr_cache_hits;
 	unsigned int nr_cache_lookups;
+	unsigned int nr_child_hits;
+	unsigned int nr_child_lookups;
 
 	struct notify *notifyhash[NOTIFY_HASH_SIZE];
 
@@ -2441,6 +2451,126 @@ static void prepare_for_open (TCHAR *name)
 {
 }
 
+/* uniq -> a_inode table, grows with the number of live a_inodes */
+static void aino_hash_add (Unit *unit, a_inode *aino)
+{
+	unit->aino_count++;
+	if (unit->aino_count > unit->aino_hash_size) {
+		unsigned int size = unit->aino_hash_size ? unit->aino_hash_size * 2 : AINO_HASH_MIN;
+		a_inode **hash = xcalloc (a_inode*, size);
+		if (hash) {
+			for (unsigned int i = 0; i < unit->aino_hash_size; i++) {
+				a_inode *a = unit->aino_hash[i];
+				while (a) {
+					a_inode *next = a->uniq_next;
+					a->uniq_next = hash[a->uniq & (size - 1)];
+					hash[a->uniq & (size - 1)] = a;
+					a = next;
+				}
+			}
+			xfree (unit->aino_hash);
+			unit->aino_hash = hash;
+			unit->aino_hash_size = size;
+		}
+	}
+	if (unit->aino_hash) {
+		a_inode **ap = &unit->aino_hash[aino->uniq & (unit->aino_hash_size - 1)];
+		aino->uniq_next = *ap;
+		*ap = aino;
+	}
+}
+
+static void aino_hash_remove (Unit *unit, a_inode *aino)
+{
+	unit->aino_count--;
+	if (!unit->aino_hash)
+		return;
+	a_inode **ap = &unit->aino_hash[aino->uniq & (unit->aino_hash_size - 1)];
+	while (*ap && *ap != aino)
+		ap = &(*ap)->uniq_next;
+	if (*ap)
+		*ap = aino->uniq_next;
+	aino->uniq_next = 0;
+}
+
+/* Case sensitive, last path component only.  */
+static unsigned int nname_hash (const TCHAR *s)
+{
+	const TCHAR *p = _tcsrchr (s, FSDB_DIR_SEPARATOR);
+	unsigned int h = 0;
+	if (p)
+		s = p + 1;
+	while (*s)
+		h = h * 31 + *s++;
+	return h;
+}
+
+static void child_hash_insert (a_inode *dir, a_inode *aino)
+{
+	unsigned int mask = dir->child_hash_size - 1;
+	a_inode **ap = &dir->child_hash[aname_hash (aino->aname) & mask];
+	a_inode **np = &dir->child_hash[dir->child_hash_size + (nname_hash (aino->nname) & mask)];
+	aino->aname_next = *ap;
+	*ap = aino;
+	aino->nname_next = *np;
+	*np = aino;
+}
+
+static bool child_hash_resize (a_inode *dir, unsigned int size)
+{
+	a_inode **hash = xcalloc (a_inode*, size * 2);
+	if (!hash)
+		return false;
+	xfree (dir->child_hash);
+	dir->child_hash = hash;
+	dir->child_hash_size = size;
+	for (a_inode *c = dir->child; c; c = c->sibling)
+		child_hash_insert (dir, c);
+	return true;
+}
+
+/* aino must already be linked into dir's child list */
+static void child_hash_add (a_inode *dir, a_inode *aino)
+{
+	dir->child_count++;
+	if (dir->child_count >= CHILD_HASH_MIN && dir->child_count > dir->child_hash_size * 2) {
+		unsigned int size = dir->child_hash_size ? dir->child_hash_size * 4 : CHILD_HASH_MIN;
+		if (child_hash_resize (dir, size))
+			return;
+	}
+	if (dir->child_hash)
+		child_hash_insert (dir, aino);
+}
+
+static void child_hash_remove (a_inode *dir, a_inode *aino)
+{
+	a_inode **ap;
+	unsigned int mask;
+
+	dir->child_count--;
+	if (!dir->child_hash)
+		return;
+	mask = dir->child_hash_size - 1;
+	ap = &dir->child_hash[aname_hash (aino->aname) & mask];
+	while (*ap && *ap != aino)
+		ap = &(*ap)->aname_next;
+	if (*ap)
+		*ap = aino->aname_next;
+	ap = &dir->child_hash[dir->child_hash_size + (nname_hash (aino->nname) & mask)];
+	while (*ap && *ap != aino)
+		ap = &(*ap)->nname_next;
+	if (*ap)
+		*ap = aino->nname_next;
+}
+
+static void child_hash_free (a_inode *dir)
+{
+	xfree (dir->child_hash);
+	dir->child_hash = 0;
+	dir->child_hash_size = 0;
+	dir->child_count = 0;
+}
+
 static void de_recycle_aino (Unit *unit, a_inode *aino)
 {
 	aino_test (aino);
@@ -2454,6 +2584,8 @@ static void de_recycle_aino (Unit *unit, a_inode *aino)
 
 static void free_aino(a_inode *aino)
 {
+	xfree(aino->child_hash);
+	fsdb_dir_free(aino);
 	xfree(aino->aname);
 	xfree(aino->comment);
 	xfree(aino->nname);
@@ -2462,9 +2594,9 @@ static void free_aino(a_inode *aino)
 
 static void dispose_aino (Unit *unit, a_inode **aip, a_inode *aino)
 {
-	int hash = aino->uniq % MAX_AINO_HASH;
-	if (unit->aino_hash[hash] == aino)
-		unit->aino_hash[hash] = 0;
+	aino_hash_remove (unit, aino);
+	if (aino->parent)
+		child_hash_remove (aino->parent, aino);
 
 	if (aino->dirty && aino->parent)
 		fsdb_dir_writeback (aino->parent);
@@ -2618,6 +2750,14 @@ static void move_aino_children (Unit *unit, a_inode *from, a_inode *to)
 	aino_test (to);
 	to->child = from->child;
 	from->child = 0;
+	/* indexes stay valid, last nname component does not change */
+	child_hash_free (to);
+	to->child_hash = from->child_hash;
+	to->child_hash_size = from->child_hash_size;
+	to->child_count = from->child_count;
+	from->child_hash = 0;
+	from->child_hash_size = 0;
+	from->child_count = 0;
 	update_child_names (unit, to->child, to);
 }
 
@@ -2696,18 +2836,20 @@ static a_inode *lookup_sub (a_inode *dir, uae_u32 uniq)
 
 static a_inode *lookup_aino (Unit *unit, uae_u32 uniq)
 {
-	a_inode *a;
-	int hash = uniq % MAX_AINO_HASH;
+	a_inode *a = 0;
 
 	if (uniq == 0)
 		return &unit->rootnode;
-	a = unit->aino_hash[hash];
-	if (a == 0 || a->uniq != uniq)
+	if (unit->aino_hash) {
+		a = unit->aino_hash[uniq & (unit->aino_hash_size - 1)];
+		while (a != 0 && a->uniq != uniq)
+			a = a->uniq_next;
+	}
+	if (a == 0)
 		a = lookup_sub (&unit->rootnode, uniq);
 	else
 		unit->nr_cache_hits++;
 	unit->nr_cache_lookups++;
-	unit->aino_hash[hash] = a;
 	aino_test (a);
 	return a;
 }
@@ -2894,6 +3036,8 @@ static void init_child_aino_tree (Unit *unit, a_inode *base, a_inode *aino)
 	base->child = aino;
 	aino->next = aino->prev = 0;
 	aino->volflags = unit->volflags;
+	aino_hash_add (unit, aino);
+	child_hash_add (base, aino);
 }
 
 static void init_child_aino (Unit *unit, a_inode *base, a_inode *aino)
@@ -2998,6 +3142,21 @@ static a_inode *create_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int is
 	return aino;
 }
 
+static bool child_aname_match (Unit *unit, a_inode *c, const TCHAR *rel, int l0)
+{
+	int l1 = uaetcslen (c->aname);
+	return l0 <= l1 && same_aname (rel, c->aname + l1 - l0)
+		&& (l0 == l1 || c->aname[l1-l0-1] == '/') && c->mountcount == unit->mountcount;
+}
+
+static bool child_nname_match (Unit *unit, a_inode *c, const TCHAR *rel, int l0)
+{
+	int l1 = uaetcslen (c->nname);
+	/* Note: using _tcscmp here.  */
+	return l0 <= l1 && _tcscmp (rel, c->nname + l1 - l0) == 0
+		&& (l0 == l1 || c->nname[l1-l0-1] == FSDB_DIR_SEPARATOR) && c->mountcount == unit->mountcount;
+}
+
 static a_inode *lookup_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int *err)
 {
 	a_inode *c = base->child;
@@ -3011,15 +3170,19 @@ static a_inode *lookup_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int *e
 		return 0;
 	}
 
-	while (c != 0) {
-		int l1 = uaetcslen (c->aname);
-		if (l0 <= l1 && same_aname (rel, c->aname + l1 - l0)
-			&& (l0 == l1 || c->aname[l1-l0-1] == '/') && c->mountcount == unit->mountcount)
-			break;
-		c = c->sibling;
+	unit->nr_child_lookups++;
+	if (base->child_hash) {
+		c = base->child_hash[aname_hash (rel) & (base->child_hash_size - 1)];
+		while (c != 0 && !child_aname_match (unit, c, rel, l0))
+			c = c->aname_next;
+	} else {
+		while (c != 0 && !child_aname_match (unit, c, rel, l0))
+			c = c->sibling;
 	}
-	if (c != 0)
+	if (c != 0) {
+		unit->nr_child_hits++;
 		return c;
+	}
 	c = new_child_aino (unit, base, rel);
 	if (c == 0)
 		*err = ERROR_OBJECT_NOT_AROUND;
@@ -3037,16 +3200,19 @@ static a_inode *lookup_child_aino_for_exnext (Unit *unit, a_inode *base, TCHAR *
 	aino_test (c);
 
 	*err = 0;
-	while (c != 0) {
-		int l1 = uaetcslen (c->nname);
-		/* Note: using _tcscmp here.  */
-		if (l0 <= l1 && _tcscmp (rel, c->nname + l1 - l0) == 0
-			&& (l0 == l1 || c->nname[l1-l0-1] == FSDB_DIR_SEPARATOR) && c->mountcount == unit->mountcount)
-			break;
-		c = c->sibling;
+	unit->nr_child_lookups++;
+	if (base->child_hash) {
+		c = base->child_hash[base->child_hash_size + (nname_hash (rel) & (base->child_hash_size - 1))];
+		while (c != 0 && !child_nname_match (unit, c, rel, l0))
+			c = c->nname_next;
+	} else {
+		while (c != 0 && !child_nname_match (unit, c, rel, l0))
+			c = c->sibling;
 	}
-	if (c != 0)
+	if (c != 0) {
+		unit->nr_child_hits++;
 		return c;
+	}
 	if (!isvirtual && !vfso)
 		c = fsdb_lookup_aino_nname (base, rel);
 	if (c == 0) {
@@ -3255,8 +3421,6 @@ static Unit *startup_create_unit(TrapContext *ctx, UnitInfo *uinfo, int num)
 	unit->rootnode.volflags = uinfo->volflags;
 	aino_test_init (&unit->rootnode);
 	unit->aino_cache_size = 0;
-	for (i = 0; i < MAX_AINO_HASH; i++)
-		unit->aino_hash[i] = 0;
 	return unit;
 }
 
@@ -3314,6 +3478,8 @@ static void filesys_start_thread (UnitInfo *ui, int nr)
 		ui->back_pipe = xmalloc (smp_comm_pipe, 1);
 		init_comm_pipe (ui->unit_pipe, 400, 3);
 		init_comm_pipe (ui->back_pipe, 100, 1);
+		uae_sem_init (&ui->reply_sem, 0, 1);
+		uae_sem_init (&ui->job_sem, 0, 0);
 		uae_start_thread (_T("filesys"), filesys_thread, (void *)ui, &ui->tid);
 	}
 #endif
@@ -4532,11 +4698,19 @@ static ExAllKey *getexall (Unit *unit, uaecptr control, int id)
 	return NULL;
 }
 
-static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control, Unit *unit, a_inode *aino)
+/* ExAll buffer fill position of current packet */
+struct exallstate
 {
-	uaecptr exp = exalldata;
-	int i;
-	int size, size2;
+	uaecptr next;
+	uaecptr last;
+	uae_u32 entries;
+};
+
+static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control, Unit *unit, a_inode *aino, const struct mystat *dirstat, struct exallstate *eas)
+{
+	uaecptr exp = eas->next;
+	int size, size2, hdrsize;
+	uae_u8 *buf;
 	int entrytype;
 	const TCHAR *xs = NULL, *commentx = NULL;
 	uae_u32 flags = 15;
@@ -4548,7 +4722,9 @@ static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, u
 	int ret = 0;
 
 	memset (&statbuf, 0, sizeof statbuf);
-	if (unit->volflags & MYVOLUMEINFO_ARCHIVE)
+	if (dirstat && !aino->elock && aino->shlock <= 0)
+		statbuf = *dirstat; /* from directory scan, open files may have stale size in directory entry */
+	else if (unit->volflags & MYVOLUMEINFO_ARCHIVE)
 		zfile_stat_archive (aino->nname, &statbuf);
 	else if (unit->volflags & MYVOLUMEINFO_CDFS)
 		isofs_stat (unit->ui.cdfs_superblock, aino->uniq_external, &statbuf);
@@ -4602,57 +4778,55 @@ static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, u
 		size2 += 8;
 	}
 
-	i = trap_get_long(ctx, control + 0);
-	while (i > 0) {
-		exp = trap_get_long(ctx, exp); /* ed_Next */
-		i--;
-	}
-
 	if (exalldata + exalldatasize - exp < size + size2)
 		goto end; /* not enough space */
 
 #if EXALL_DEBUG > 0
 	write_log (_T("ID=%d, %d, %08x: '%s'%s\n"),
-		trap_get_long(ctx, control + 4), trap_get_long(ctx, control + 0), exp, xs, aino->dir ? _T(" [DIR]") : _T(""));
+		trap_get_long(ctx, control + 4), eas->entries, exp, xs, aino->dir ? _T(" [DIR]") : _T(""));
 #endif
 
-	trap_put_long(ctx, exp, exp + size + size2); /* ed_Next */
+	/* build whole ExAllData in host memory, single transfer */
+	hdrsize = size2;
+	buf = xcalloc (uae_u8, size + size2);
+	if (!buf)
+		goto end;
+	put_long_host(buf + 0, exp + size + size2); /* ed_Next */
 	if (type >= 1) {
-		trap_put_long(ctx, exp + 4, exp + size2);
-		for (i = 0; i <= strlen (x); i++) {
-			trap_put_byte(ctx, exp + size2, x[i]);
-			size2++;
-		}
+		put_long_host(buf + 4, exp + size2);
+		memcpy (buf + size2, x, strlen (x) + 1);
+		size2 += uaestrlen (x) + 1;
 	}
 	if (type >= 2)
-		trap_put_long(ctx, exp + 8, entrytype);
+		put_long_host(buf + 8, entrytype);
 	if (type >= 3)
-		trap_put_long(ctx, exp + 12, (uae_u32)(statbuf.size > MAXFILESIZE32 ? MAXFILESIZE32 : statbuf.size));
+		put_long_host(buf + 12, (uae_u32)(statbuf.size > MAXFILESIZE32 ? MAXFILESIZE32 : statbuf.size));
 	if (type >= 4)
-		trap_put_long(ctx, exp + 16, flags);
+		put_long_host(buf + 16, flags);
 	if (type >= 5) {
-		trap_put_long(ctx, exp + 20, days);
-		trap_put_long(ctx, exp + 24, mins);
-		trap_put_long(ctx, exp + 28, ticks);
+		put_long_host(buf + 20, days);
+		put_long_host(buf + 24, mins);
+		put_long_host(buf + 28, ticks);
 	}
 	if (type >= 6) {
-		trap_put_long(ctx, exp + 32, exp + size2);
-		trap_put_byte(ctx, exp + size2, (uae_u8)strlen(comment));
-		for (i = 0; i <= strlen (comment); i++) {
-			trap_put_byte(ctx, exp + size2, comment[i]);
-			size2++;
-		}
+		put_long_host(buf + 32, exp + size2);
+		memcpy (buf + size2, comment, strlen (comment) + 1);
+		size2 += uaestrlen (comment) + 1;
 	}
 	if (type >= 7) {
-		trap_put_word(ctx, exp + 36, uid);
-		trap_put_word(ctx, exp + 38, gid);
+		put_word_host(buf + 36, uid);
+		put_word_host(buf + 38, gid);
 	}
 	if (type >= 8) {
-		trap_put_long(ctx, exp + 40, statbuf.size >> 32);
-		trap_put_long(ctx, exp + 44, (uae_u32)statbuf.size);
+		put_long_host(buf + 40, statbuf.size >> 32);
+		put_long_host(buf + 44, (uae_u32)statbuf.size);
 	}
+	trap_put_bytes(ctx, buf, exp, size + hdrsize);
+	xfree (buf);
 
-	trap_put_long(ctx, control + 0, trap_get_long(ctx, control + 0) + 1);
+	eas->last = exp;
+	eas->next = exp + size + hdrsize;
+	eas->entries++;
 	ret = 1;
 end:
 	xfree (x);
@@ -4677,13 +4851,14 @@ static int filesys_readdir(struct fs_dirhandle *d, TCHAR *fn, uae_u64 *uniq)
 	return ok;
 }
 
-static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExAllKey *eak, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control)
+static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExAllKey *eak, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control, struct exallstate *eas)
 {
 	a_inode *aino, *base = NULL;
 	int ok;
 	uae_u32 err;
 	struct fs_dirhandle *d;
 	TCHAR fn[MAX_DPATH];
+	struct mystat statbuf;
 
 	if (lock != 0)
 		base = aino_from_lock(ctx, unit, lock);
@@ -4691,6 +4866,7 @@ static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExA
 		base = &unit->rootnode;
 	for (;;) {
 		uae_u64 uniq = 0;
+		const struct mystat *dirstat = NULL;
 		d = eak->dirhandle;
 		if (!eak->fn) {
 			do {
@@ -4698,6 +4874,8 @@ static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExA
 			} while (ok && d->fstype == FS_DIRECTORY && (filesys_name_invalid (fn) || fsdb_name_invalid_dir (NULL, fn)));
 			if (!ok)
 				return 0;
+			if (d->fstype == FS_DIRECTORY && my_readdir_stat (d->od, &statbuf))
+				dirstat = &statbuf;
 		} else {
 			_tcscpy (fn, eak->fn);
 			xfree (eak->fn);
@@ -4708,7 +4886,7 @@ static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExA
 			return 0;
 		eak->id = unit->exallid++;
 		trap_put_long(ctx, control + 4, eak->id);
-		if (!exalldo(ctx, exalldata, exalldatasize, type, control, unit, aino)) {
+		if (!exalldo(ctx, exalldata, exalldatasize, type, control, unit, aino, dirstat, eas)) {
 			eak->fn = my_strdup (fn); /* no space in exallstruct, save current entry */
 			break;
 		}
@@ -4760,11 +4938,14 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 	ExAllKey *eak = NULL;
 	a_inode *base = NULL;
 	struct fs_dirhandle *d;
-	int ok, i;
-	uaecptr exp;
+	int ok;
+	struct exallstate eas;
 	uae_u32 id, doserr = ERROR_NO_MORE_ENTRIES;
 
 	ok = 0;
+	eas.next = exalldata;
+	eas.last = 0;
+	eas.entries = 0;
 
 #if EXALL_DEBUG > 0
 	write_log (_T("exall: %08x %08x-%08x %d %d %08x\n"),
@@ -4797,9 +4978,9 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 			doserr = ERROR_OBJECT_WRONG_TYPE;
 			goto fail;
 		}
-		if (!action_examine_all_do(ctx, unit, lock, eak, exalldata, exalldatasize, type, control))
+		if (!action_examine_all_do(ctx, unit, lock, eak, exalldata, exalldatasize, type, control, &eas))
 			goto fail;
-		if (trap_get_long(ctx, control + 0) == 0) {
+		if (eas.entries == 0) {
 			/* uh, no space for first entry.. */
 			doserr = ERROR_NO_FREE_STORE;
 			goto fail;
@@ -4822,9 +5003,9 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 			goto fail;
 		eak->dirhandle = d;
 		trap_put_long(ctx, control + 4, eak->id);
-		if (!action_examine_all_do(ctx, unit, lock, eak, exalldata, exalldatasize, type, control))
+		if (!action_examine_all_do(ctx, unit, lock, eak, exalldata, exalldatasize, type, control, &eas))
 			goto fail;
-		if (trap_get_long(ctx, control + 0) == 0) {
+		if (eas.entries == 0) {
 			/* uh, no space for first entry.. */
 			doserr = ERROR_NO_FREE_STORE;
 			goto fail;
@@ -4834,20 +5015,14 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 	ok = 1;
 
 fail:
+	trap_put_long(ctx, control + 0, eas.entries); /* eac_Entries */
 	/* Clear last ed_Next. This "list" is quite non-Amiga like.. */
-	exp = exalldata;
-	i = trap_get_long(ctx, control + 0);
-	for (;;) {
-		if (i <= 1) {
-			if (exp)
-				trap_put_long(ctx, exp, 0);
-			break;
-		}
-		exp = trap_get_long(ctx, exp); /* ed_Next */
-		i--;
-	}
+	if (eas.last)
+		trap_put_long(ctx, eas.last, 0);
+	else if (exalldata)
+		trap_put_long(ctx, exalldata, 0);
 #if EXALL_DEBUG > 0
-	write_log("ok=%d, err=%d, eac_Entries = %d\n", ok, ok ? -1 : doserr, trap_get_long(ctx, control + 0));
+	write_log("ok=%d, err=%d, eac_Entries = %d\n", ok, ok ? -1 : doserr, eas.entries);
 #endif
 
 	if (!ok) {
@@ -5411,6 +5586,9 @@ static void	action_end(TrapContext *ctx, Unit *unit, dpacket *packet)
 	PUT_PCK_RES2 (packet, 0);
 }
 
+/* bounce buffer size for transfers that can't go directly to Amiga memory */
+#define FS_BULK_SIZE (256 * 1024)
+
 static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 {
 	Key *k = lookup_key (unit, GET_PCK_ARG1 (packet));
@@ -5431,10 +5609,10 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 		PUT_PCK_RES2 (packet, 0);
 	} else if (k->aino->vfso) {
 		uae_s64 filesize = k->aino->vfso->size;
-		for (int i = 0; i < size && k->file_pos < filesize; i++) {
-			trap_put_byte(ctx, addr + i, k->aino->vfso->data[k->file_pos]);
-			k->file_pos++;
-			actual++;
+		if (k->file_pos < filesize) {
+			actual = filesize - k->file_pos < size ? (uae_u32)(filesize - k->file_pos) : size;
+			trap_put_bytes(ctx, k->aino->vfso->data + k->file_pos, addr, actual);
+			k->file_pos += actual;
 		}
 		PUT_PCK_RES1 (packet, actual);
 		size = 0;
@@ -5494,10 +5672,17 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 
 		if (trap_is_indirect() || !real_address_allowed()) {
 
-			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
+			/* read ahead in large blocks, trap_put_bytes() splits them */
+			uae_u32 bufsize = size > FS_BULK_SIZE ? FS_BULK_SIZE : size;
+			uae_u8 *buf = xmalloc (uae_u8, bufsize);
+			if (!buf) {
+				PUT_PCK_RES1 (packet, -1);
+				PUT_PCK_RES2 (packet, ERROR_NO_FREE_STORE);
+				return;
+			}
 			actual = 0;
 			while (size > 0) {
-				int toread = size > RTAREA_TRAP_DATA_EXTRA_SIZE ? RTAREA_TRAP_DATA_EXTRA_SIZE : size;
+				int toread = size > bufsize ? bufsize : size;
 				int read = fs_read(k->fd, buf, toread);
 				if (read < 0) {
 					actual = -1;
@@ -5512,6 +5697,7 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 				if (read < toread)
 					break;
 			}
+			xfree (buf);
 
 		} else {
 
@@ -5575,11 +5761,18 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 
 		if (trap_is_indirect() || !real_address_allowed()) {
 
-			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
+			/* gather large blocks, one host write per block */
+			int bufsize = size > FS_BULK_SIZE ? FS_BULK_SIZE : size;
+			buf = xmalloc (uae_u8, bufsize);
+			if (!buf) {
+				PUT_PCK_RES1 (packet, -1);
+				PUT_PCK_RES2 (packet, ERROR_NO_FREE_STORE);
+				return;
+			}
 			actual = 0;
 			int sizecnt = size;
 			while (sizecnt > 0) {
-				int towrite = sizecnt > RTAREA_TRAP_DATA_EXTRA_SIZE ? RTAREA_TRAP_DATA_EXTRA_SIZE : sizecnt;
+				int towrite = sizecnt > bufsize ? bufsize : sizecnt;
 				trap_get_bytes(ctx, buf, addr, towrite);
 				int write = fs_write(k->fd, buf, towrite);
 				if (write < 0) {
@@ -5594,6 +5787,7 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 				if (write < towrite)
 					break;
 			}
+			xfree (buf);
 
 		} else {
 
@@ -6289,7 +6483,9 @@ static void	action_rename_object(TrapContext *ctx, Unit *unit, dpacket *packet)
 	a2->comment = a1->comment;
 	a1->comment = 0;
 	a2->amigaos_mode = a1->amigaos_mode;
+	aino_hash_remove (unit, a2);
 	a2->uniq = a1->uniq;
+	aino_hash_add (unit, a2);
 	a2->elock = a1->elock;
 	a2->shlock = a1->shlock;
 	a2->has_dbentry = a1->has_dbentry;
@@ -7128,6 +7324,190 @@ static int handle_packet(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg
 
 #ifdef UAE_FILESYS_THREADS
 
+/* ACTION_READ and ACTION_WRITE on plain host files only touch their own
+ * Key, so the unit thread hands them to a small worker pool and keeps
+ * going. Packets on the same handle are never in flight twice, so they
+ * complete in order. Everything else runs on the unit thread after all
+ * workers are idle, so no other Unit state is ever shared. */
+#define FS_WORKERS 3
+
+struct fs_job {
+	TrapContext *ctx;
+	Key *k;
+	dpacket packet;
+	uaecptr msg;
+};
+
+struct fs_worker {
+	UnitInfo *ui;
+	smp_comm_pipe pipe;
+	uae_thread_id tid;
+	volatile int busy;
+	volatile int state;
+};
+
+/* Reply to the packet and return the unit's lock list. reply_sem is held
+ * because the worker threads also touch the lock list. */
+static void filesys_reply(TrapContext *ctx, UnitInfo *ui, dpacket *packet, uaecptr msg, int ret)
+{
+	if (!ret) {
+		PUT_PCK_RES1 (packet, DOS_FALSE);
+		PUT_PCK_RES2 (packet, ERROR_ACTION_NOT_KNOWN);
+	}
+	writedpacket(ctx, packet);
+
+	trapmd md2[] = {
+		{ TRAPCMD_PUT_LONG, { msg + 4, 0xffffffff } },
+		{ TRAPCMD_GET_LONG, { ui->self->locklist } },
+		{ TRAPCMD_PUT_LONG, { ui->self->locklist, 0 } }
+	};
+	struct trapmd *mdp;
+	int mdcnt;
+	if (ret >= 0) {
+		mdp = &md2[0];
+		mdcnt = 3;
+		/* Mark the packet as processed for the list scan in the assembly code. */
+		//trap_put_long(ctx, msg + 4, 0xffffffff);
+	} else {
+		mdp = &md2[1];
+		mdcnt = 2;
+	}
+	uae_sem_wait(&ui->reply_sem);
+	/* Acquire the message lock, so that we know we can safely send the message. */
+	ui->self->cmds_sent++;
+
+	/* Send back the locks. */
+	trap_multi(ctx, mdp, mdcnt);
+	if (md2[1].params[0] != 0)
+		write_comm_pipe_int(ui->back_pipe, (int)md2[1].params[0], 0);
+	uae_sem_post(&ui->reply_sem);
+
+	/* The message is sent by our interrupt handler, so make sure an interrupt happens. */
+	do_uae_int_requested();
+#if 0
+	uae_u32 v = trap_get_long(ctx, ui->self->locklist);
+	if (v != 0)
+		write_comm_pipe_int (ui->back_pipe, (int)v, 0);
+	trap_put_long(ctx, ui->self->locklist, 0);
+#endif
+
+	trap_background_set_complete(ctx);
+}
+
+static void filesys_worker(void *v)
+{
+	struct fs_worker *w = (struct fs_worker*)v;
+	UnitInfo *ui = w->ui;
+
+	uae_set_thread_priority (NULL, 1);
+	w->state = 1;
+	for (;;) {
+		struct fs_job *job = (struct fs_job*)read_comm_pipe_pvoid_blocking(&w->pipe);
+		if (!job)
+			break;
+		int ret = handle_packet(job->ctx, ui->self, &job->packet, job->msg, 1);
+		filesys_reply(job->ctx, ui, &job->packet, job->msg, ret);
+		job->k->busy = 0;
+		xfree(job);
+		w->busy = 0;
+		uae_sem_post(&ui->job_sem);
+	}
+	w->state = 0;
+}
+
+/* started on the first queued packet, units that never see a plain
+ * host file read or write (CD, archives) get no threads */
+static void filesys_start_workers(UnitInfo *ui)
+{
+	ui->workers = xcalloc(struct fs_worker, FS_WORKERS);
+	if (!ui->workers)
+		return;
+	for (int i = 0; i < FS_WORKERS; i++) {
+		struct fs_worker *w = &ui->workers[i];
+		w->ui = ui;
+		init_comm_pipe(&w->pipe, 10, 1);
+		w->state = -1;
+		uae_start_thread(_T("filesys worker"), filesys_worker, w, &w->tid);
+	}
+}
+
+/* wait until no packet is in progress on any worker */
+static void filesys_wait_workers(UnitInfo *ui)
+{
+	if (!ui->workers)
+		return;
+	for (;;) {
+		int i;
+		for (i = 0; i < FS_WORKERS; i++) {
+			if (ui->workers[i].busy)
+				break;
+		}
+		if (i == FS_WORKERS)
+			return;
+		uae_sem_wait(&ui->job_sem);
+	}
+}
+
+static void filesys_stop_workers(UnitInfo *ui)
+{
+	if (ui->workers) {
+		filesys_wait_workers(ui);
+		for (int i = 0; i < FS_WORKERS; i++) {
+			struct fs_worker *w = &ui->workers[i];
+			write_comm_pipe_pvoid(&w->pipe, NULL, 1);
+			while (w->state)
+				sleep_millis(1);
+			uae_end_thread(&w->tid);
+			destroy_comm_pipe(&w->pipe);
+		}
+		xfree(ui->workers);
+		ui->workers = NULL;
+	}
+	uae_sem_destroy(&ui->job_sem);
+	uae_sem_destroy(&ui->reply_sem);
+}
+
+/* Key of a packet that can run on a worker, NULL if it must run here */
+static Key *filesys_worker_key(Unit *unit, dpacket *packet, int isvolume)
+{
+	uae_s32 type = GET_PCK_TYPE (packet);
+	if (type != ACTION_READ && type != ACTION_WRITE)
+		return NULL;
+	if (!isvolume || unit->inhibited)
+		return NULL;
+	Key *k = lookup_key (unit, GET_PCK_ARG1 (packet));
+	if (!k || !k->fd || k->fd->fstype != FS_DIRECTORY || k->aino->vfso)
+		return NULL;
+	return k;
+}
+
+/* queue packet to an idle worker, waiting for the handle's previous
+ * packet first so that per-handle order is kept */
+static void filesys_queue_job(UnitInfo *ui, TrapContext *ctx, Key *k, dpacket *packet, uaecptr msg)
+{
+	struct fs_job *job = xmalloc(struct fs_job, 1);
+	job->ctx = ctx;
+	job->k = k;
+	job->msg = msg;
+	job->packet = *packet;
+	if (packet->packet_data == packet->packet_array)
+		job->packet.packet_data = job->packet.packet_array;
+	for (;;) {
+		if (!k->busy) {
+			for (int i = 0; i < FS_WORKERS; i++) {
+				struct fs_worker *w = &ui->workers[i];
+				if (!w->busy) {
+					k->busy = 1;
+					w->busy = 1;
+					write_comm_pipe_pvoid(&w->pipe, job, 1);
+					return;
+				}
+			}
+		}
+		uae_sem_wait(&ui->job_sem);
+	}
+}
+
 static int filesys_iteration(UnitInfo *ui)
 {
 	uaecptr pck;
@@ -7145,6 +7525,7 @@ static int filesys_iteration(UnitInfo *ui)
 		if (pck != 0)
 		   return 1;
 		/* Death message received. */
+		filesys_stop_workers (ui);
 		uae_sem_post (&ui->reset_sync_sem);
 		/* Die.  */
 		return 0;
@@ -7154,6 +7535,7 @@ static int filesys_iteration(UnitInfo *ui)
 	readdpacket(ctx, &packet, pck);
 
 	int isvolume = 0;
+	uae_sem_wait(&ui->reply_sem);
 #if TRAPMD
 	trapmd md[] = {
 		{ TRAPCMD_GET_LONG, { morelocks }, 2, 0 },
@@ -7174,48 +7556,19 @@ static int filesys_iteration(UnitInfo *ui)
 		isvolume = trap_get_byte(ctx, ui->self->volume + 64) || ui->self->ui.unknown_media;
 	}
 #endif
+	uae_sem_post(&ui->reply_sem);
 
-	int ret = handle_packet(ctx, ui->self, &packet, msg, isvolume);
-	if (!ret) {
-		PUT_PCK_RES1 (&packet, DOS_FALSE);
-		PUT_PCK_RES2 (&packet, ERROR_ACTION_NOT_KNOWN);
-	}
-	writedpacket(ctx, &packet);
-
-	trapmd md2[] = {
-		{ TRAPCMD_PUT_LONG, { msg + 4, 0xffffffff } },
-		{ TRAPCMD_GET_LONG, { ui->self->locklist } },
-		{ TRAPCMD_PUT_LONG, { ui->self->locklist, 0 } }
-	};
-	struct trapmd *mdp;
-	int mdcnt;
-	if (ret >= 0) {
-		mdp = &md2[0];
-		mdcnt = 3;
-		/* Mark the packet as processed for the list scan in the assembly code. */
-		//trap_put_long(ctx, msg + 4, 0xffffffff);
-	} else {
-		mdp = &md2[1];
-		mdcnt = 2;
+	Key *k = filesys_worker_key(ui->self, &packet, isvolume);
+	if (k && !ui->workers)
+		filesys_start_workers(ui);
+	if (k && ui->workers) {
+		filesys_queue_job(ui, ctx, k, &packet, msg);
+		return 1;
 	}
-	/* Acquire the message lock, so that we know we can safely send the message. */
-	ui->self->cmds_sent++;
+	filesys_wait_workers(ui);
 
-	/* Send back the locks. */
-	trap_multi(ctx, mdp, mdcnt);
-	if (md2[1].params[0] != 0)
-		write_comm_pipe_int(ui->back_pipe, (int)md2[1].params[0], 0);
-
-	/* The message is sent by our interrupt handler, so make sure an interrupt happens. */
-	do_uae_int_requested();
-#if 0
-	uae_u32 v = trap_get_long(ctx, ui->self->locklist);
-	if (v != 0)
-		write_comm_pipe_int (ui->back_pipe, (int)v, 0);
-	trap_put_long(ctx, ui->self->locklist, 0);
-#endif
-
-	trap_background_set_complete(ctx);
+	int ret = handle_packet(ctx, ui->self, &packet, msg, isvolume);
+	filesys_reply(ctx, ui, &packet, msg, ret);
 	return 1;
 }
 
@@ -7352,7 +7705,16 @@ void filesys_free_handles (void)
 			xfree (lr);
 		}
 		u->waitingrecords = NULL;
+		if (u->nr_cache_lookups || u->nr_child_lookups)
+			write_log (_T("FS: unit %d: %u a_inodes, uniq lookups %u/%u, child lookups %u/%u\n"),
+				u->unit, u->aino_count, u->nr_cache_hits, u->nr_cache_lookups, u->nr_child_hits, u->nr_child_lookups);
 		free_all_ainos (u, &u->rootnode);
+		child_hash_free (&u->rootnode);
+		fsdb_dir_free (&u->rootnode);
+		xfree (u->aino_hash);
+		u->aino_hash = NULL;
+		u->aino_hash_size = 0;
+		u->aino_count = 0;
 		u->rootnode.next = u->rootnode.prev = &u->rootnode;
 		u->aino_cache_size = 0;
 		xfree (u->newrootdir);
@@ -21,6 +21,7 @@
 #include "fsusage.h"
 #include "scsidev.h"
 #include "fsdb.h"
+#include "zfile.h"
 #include "uae/io.h"
 
 /* The on-disk format is as follows:
@@ -29,8 +30,13 @@
 * Offset 5, 257 bytes, aname
 * Offset 263, 257 bytes, nname
 * Offset 519, 81 bytes, comment
+*
+* Each directory keeps the file contents in memory with a hashed aname
+* and nname index, revalidated against the file's size and date.
 */
 
+#define FSDB_ENTRY_SIZE (1 + 4 + 257 + 257 + 81)
+
 #define TRACING_ENABLED 0
 #if TRACING_ENABLED
 #define TRACE(x) do { write_log x; } while(0)
@@ -75,6 +81,158 @@ TCHAR *fsdb_search_dir (const TCHAR *dirname, TCHAR *rel)
 }
 #endif
 
+struct fsdb_dircache
+{
+	uae_u8 *data;
+	int entries;
+	int indexed;
+	uae_s64 size;
+	struct mytimeval mtime;
+	TCHAR **anames, **nnames;
+	int hashsize;
+	int *ahash, *nhash;
+	int *anext, *nnext;
+};
+
+static unsigned int fsdb_hash (const TCHAR *s, bool nocase)
+{
+	unsigned int h = 0;
+	if (nocase)
+		return aname_hash (s);
+	while (*s)
+		h = h * 31 + *s++;
+	return h;
+}
+
+static void fsdb_cache_unindex (struct fsdb_dircache *dc)
+{
+	for (int i = 0; dc->anames && i < dc->indexed; i++) {
+		xfree (dc->anames[i]);
+		xfree (dc->nnames[i]);
+	}
+	xfree (dc->anames);
+	xfree (dc->nnames);
+	xfree (dc->ahash);
+	dc->anames = dc->nnames = NULL;
+	dc->ahash = dc->nhash = dc->anext = dc->nnext = NULL;
+	dc->hashsize = 0;
+	dc->indexed = 0;
+}
+
+/* Chains are built backwards so that they are in file order */
+static bool fsdb_cache_index (struct fsdb_dircache *dc)
+{
+	fsdb_cache_unindex (dc);
+	dc->hashsize = 16;
+	while (dc->hashsize < dc->entries)
+		dc->hashsize *= 2;
+	dc->anames = xcalloc (TCHAR*, dc->entries + 1);
+	dc->nnames = xcalloc (TCHAR*, dc->entries + 1);
+	dc->ahash = xmalloc (int, 2 * dc->hashsize + 2 * (dc->entries + 1));
+	if (!dc->anames || !dc->nnames || !dc->ahash) {
+		fsdb_cache_unindex (dc);
+		return false;
+	}
+	dc->nhash = dc->ahash + dc->hashsize;
+	dc->anext = dc->nhash + dc->hashsize;
+	dc->nnext = dc->anext + dc->entries + 1;
+	for (int i = 0; i < 2 * dc->hashsize; i++)
+		dc->ahash[i] = -1;
+	dc->indexed = dc->entries;
+	for (int i = dc->entries - 1; i >= 0; i--) {
+		uae_u8 *buf = dc->data + i * FSDB_ENTRY_SIZE;
+		unsigned int h;
+		dc->anames[i] = au ((char*)buf + 5);
+		dc->nnames[i] = au ((char*)buf + 5 + 257);
+		h = fsdb_hash (dc->anames[i], true) & (dc->hashsize - 1);
+		dc->anext[i] = dc->ahash[h];
+		dc->ahash[h] = i;
+		h = fsdb_hash (dc->nnames[i], false) & (dc->hashsize - 1);
+		dc->nnext[i] = dc->nhash[h];
+		dc->nhash[h] = i;
+	}
+	return true;
+}
+
+void fsdb_dir_free (a_inode *dir)
+{
+	struct fsdb_dircache *dc = dir->dbcache;
+	if (!dc)
+		return;
+	fsdb_cache_unindex (dc);
+	xfree (dc->data);
+	xfree (dc);
+	dir->dbcache = NULL;
+}
+
+static void fsdb_cache_setstat (struct fsdb_dircache *dc, struct mystat *st)
+{
+	dc->size = st->size;
+	dc->mtime = st->mtime;
+}
+
+/* Returns the directory's fsdb contents, NULL if it has no fsdb file */
+static struct fsdb_dircache *fsdb_cache_get (a_inode *dir)
+{
+	struct fsdb_dircache *dc = dir->dbcache;
+	struct mystat st;
+	TCHAR *n;
+	FILE *f;
+
+	if (!dir->nname)
+		return NULL;
+	n = build_nname (dir->nname, FSDB_FILE);
+	if (!my_stat (n, &st)) {
+		xfree (n);
+		fsdb_dir_free (dir);
+		return NULL;
+	}
+	if (dc && dc->size == st.size && dc->mtime.tv_sec == st.mtime.tv_sec && dc->mtime.tv_usec == st.mtime.tv_usec) {
+		xfree (n);
+		return dc;
+	}
+	fsdb_dir_free (dir);
+	f = uae_tfopen (n, _T("rb"));
+	xfree (n);
+	if (!f)
+		return NULL;
+	dc = xcalloc (struct fsdb_dircache, 1);
+	if (!dc) {
+		fclose (f);
+		return NULL;
+	}
+	dc->entries = (int)(st.size / FSDB_ENTRY_SIZE);
+	dc->data = xmalloc (uae_u8, dc->entries * FSDB_ENTRY_SIZE + 1);
+	if (dc->data)
+		dc->entries = (int)fread (dc->data, FSDB_ENTRY_SIZE, dc->entries, f);
+	fclose (f);
+	if (!dc->data || !fsdb_cache_index (dc)) {
+		xfree (dc->data);
+		xfree (dc);
+		return NULL;
+	}
+	fsdb_cache_setstat (dc, &st);
+	dir->dbcache = dc;
+	TRACE ((_T("fsdb '%s' loaded, %d entries\n"), dir->nname, dc->entries));
+	return dc;
+}
+
+/* Mirror a record written by write_aino(), index is rebuilt afterwards */
+static bool fsdb_cache_put (struct fsdb_dircache *dc, long offset, const uae_u8 *buf)
+{
+	int idx = offset / FSDB_ENTRY_SIZE;
+	if (idx >= dc->entries) {
+		uae_u8 *data = xrealloc (uae_u8, dc->data, (idx + 1) * FSDB_ENTRY_SIZE);
+		if (!data)
+			return false;
+		dc->data = data;
+		memset (dc->data + dc->entries * FSDB_ENTRY_SIZE, 0, (idx + 1 - dc->entries) * FSDB_ENTRY_SIZE);
+		dc->entries = idx + 1;
+	}
+	memcpy (dc->data + idx * FSDB_ENTRY_SIZE, buf, FSDB_ENTRY_SIZE);
+	return true;
+}
+
 static FILE *get_fsdb (a_inode *dir, const TCHAR *mode)
 {
 	TCHAR *n;
@@ -92,6 +250,7 @@ static void kill_fsdb (a_inode *dir)
 {
 	if (!dir->nname)
 		return;
+	fsdb_dir_free (dir);
 	TCHAR *n = build_nname (dir->nname, FSDB_FILE);
 	_wunlink (n);
 	xfree (n);
@@ -128,6 +287,7 @@ void fsdb_clean_dir (a_inode *dir)
 
 	if (!dir->nname)
 		return;
+	fsdb_dir_free (dir);
 	n = build_nname (dir->nname, FSDB_FILE);
 	f = uae_tfopen (n, _T("r+b"));
 	if (f == 0) {
@@ -180,89 +340,65 @@ static a_inode *aino_from_buf (a_inode *base, uae_u8 *buf, long off)
 	return aino;
 }
 
+static int fsdb_find_nname (struct fsdb_dircache *dc, const TCHAR *nname)
+{
+	int i = dc->nhash[fsdb_hash (nname, false) & (dc->hashsize - 1)];
+	while (i >= 0) {
+		if (dc->data[i * FSDB_ENTRY_SIZE] != 0 && _tcscmp (dc->nnames[i], nname) == 0)
+			return i;
+		i = dc->nnext[i];
+	}
+	return -1;
+}
+
 a_inode *fsdb_lookup_aino_aname (a_inode *base, const TCHAR *aname)
 {
-	FILE *f;
+	struct fsdb_dircache *dc;
+	int i;
 
-	f = get_fsdb (base, _T("r+b"));
-	if (f == 0) {
+	dc = fsdb_cache_get (base);
+	if (dc == 0) {
 		if (currprefs.filesys_custom_uaefsdb && (base->volflags & MYVOLUMEINFO_STREAMS))
 			return custom_fsdb_lookup_aino_aname (base, aname);
 		return 0;
 	}
-	for (;;) {
-		uae_u8 buf[1 + 4 + 257 + 257 + 81];
-		TCHAR *s;
-		if (fread (buf, 1, sizeof buf, f) < sizeof buf)
-			break;
-		s = au ((char*)buf + 5);
-		if (buf[0] != 0 && same_aname (s, aname)) {
-			long pos = ftell (f) - sizeof buf;
-			fclose (f);
-			xfree (s);
-			return aino_from_buf (base, buf, pos);
-		}
-		xfree (s);
+	i = dc->ahash[fsdb_hash (aname, true) & (dc->hashsize - 1)];
+	while (i >= 0) {
+		if (dc->data[i * FSDB_ENTRY_SIZE] != 0 && same_aname (dc->anames[i], aname))
+			return aino_from_buf (base, dc->data + i * FSDB_ENTRY_SIZE, i * FSDB_ENTRY_SIZE);
+		i = dc->anext[i];
 	}
-	fclose (f);
 	return 0;
 }
 
 a_inode *fsdb_lookup_aino_nname (a_inode *base, const TCHAR *nname)
 {
-	FILE *f;
-	char *s;
+	struct fsdb_dircache *dc;
+	int i;
 
-	f = get_fsdb (base, _T("r+b"));
-	if (f == 0) {
+	dc = fsdb_cache_get (base);
+	if (dc == 0) {
 		if (currprefs.filesys_custom_uaefsdb && (base->volflags & MYVOLUMEINFO_STREAMS))
 			return custom_fsdb_lookup_aino_nname (base, nname);
 		return 0;
 	}
-	s = ua (nname);
-	for (;;) {
-		uae_u8 buf[1 + 4 + 257 + 257 + 81];
-		if (fread (buf, 1, sizeof buf, f) < sizeof buf)
-			break;
-		if (buf[0] != 0 && strcmp ((char*)buf + 5 + 257, s) == 0) {
-			long pos = ftell (f) - sizeof buf;
-			fclose (f);
-			xfree (s);
-			return aino_from_buf (base, buf, pos);
-		}
-	}
-	xfree (s);
-	fclose (f);
-	return 0;
+	i = fsdb_find_nname (dc, nname);
+	if (i < 0)
+		return 0;
+	return aino_from_buf (base, dc->data + i * FSDB_ENTRY_SIZE, i * FSDB_ENTRY_SIZE);
 }
 
 int fsdb_used_as_nname (a_inode *base, const TCHAR *nname)
 {
-	FILE *f;
-	uae_u8 buf[1 + 4 + 257 + 257 + 81];
+	struct fsdb_dircache *dc;
 
-	f = get_fsdb (base, _T("r+b"));
-	if (f == 0) {
+	dc = fsdb_cache_get (base);
+	if (dc == 0) {
 		if (currprefs.filesys_custom_uaefsdb && (base->volflags & MYVOLUMEINFO_STREAMS))
 			return custom_fsdb_used_as_nname (base, nname);
 		return 0;
 	}
-	for (;;) {
-		TCHAR *s;
-		if (fread (buf, 1, sizeof buf, f) < sizeof buf)
-			break;
-		if (buf[0] == 0)
-			continue;
-		s = au ((char*)buf + 5 + 257);
-		if (_tcscmp (s, nname) == 0) {
-			xfree (s);
-			fclose (f);
-			return 1;
-		}
-		xfree (s);
-	}
-	fclose (f);
-	return 0;
+	return fsdb_find_nname (dc, nname) >= 0;
 }
 
 static int needs_dbentry (a_inode *aino)
@@ -279,7 +415,7 @@ static int needs_dbentry (a_inode *aino)
 	return _tcscmp (nn_begin, aino->aname) != 0;
 }
 
-static void write_aino (FILE *f, a_inode *aino)
+static void write_aino (FILE *f, a_inode *aino, struct fsdb_dircache *dc)
 {
 	uae_u8 buf[1 + 4 + 257 + 257 + 81] = { 0 };
 
@@ -293,6 +429,8 @@ static void write_aino (FILE *f, a_inode *aino)
 	buf[5 + 2 * 257 + 80] = '\0';
 	aino->db_offset = ftell (f);
 	fwrite (buf, 1, sizeof buf, f);
+	if (dc)
+		fsdb_cache_put (dc, aino->db_offset, buf);
 	aino->has_dbentry = aino->needs_dbentry;
 	TRACE ((_T("%d '%s' '%s' written\n"), aino->db_offset, aino->aname, aino->nname));
 }
@@ -305,8 +443,9 @@ void fsdb_dir_writeback (a_inode *dir)
 	int changes_needed = 0;
 	int entries_needed = 0;
 	a_inode *aino;
-	uae_u8 *tmpbuf;
-	int size, i;
+	struct fsdb_dircache *dc;
+	struct mystat st;
+	TCHAR *n;
 
 	TRACE ((_T("fsdb writeback %s\n"), dir->aname));
 	/* First pass: clear dirty bits where unnecessary, and see if any work
@@ -339,6 +478,7 @@ void fsdb_dir_writeback (a_inode *dir)
 		return;
 	}
 
+	dc = fsdb_cache_get (dir);
 	f = get_fsdb (dir, _T("r+b"));
 	if (f == 0) {
 		if ((currprefs.filesys_custom_uaefsdb  && (dir->volflags & MYVOLUMEINFO_STREAMS)) || currprefs.filesys_no_uaefsdb) {
@@ -356,30 +496,24 @@ void fsdb_dir_writeback (a_inode *dir)
 			return;
 		}
 	}
-	fseek (f, 0, SEEK_END);
-	size = ftell (f);
-	fseek (f, 0, SEEK_SET);
-	tmpbuf = 0;
-	if (size > 0) {
-		tmpbuf = (uae_u8*)malloc (size);
-		fread (tmpbuf, 1, size, f);
-	}
-	TRACE ((_T("**** updating '%s' %d\n"), dir->aname, size));
+	TRACE ((_T("**** updating '%s' %d\n"), dir->aname, dc ? dc->entries : 0));
 
 	for (aino = dir->child; aino; aino = aino->sibling) {
 		if (! aino->dirty)
 			continue;
 		aino->dirty = 0;
 
-		i = 0;
-		while (!aino->has_dbentry && i < size) {
-			TCHAR *s = au ((char*)tmpbuf + i +  5);
-			if (!_tcscmp (s, aino->aname)) {
-				aino->has_dbentry = 1;
-				aino->db_offset = i;
+		if (!aino->has_dbentry && dc) {
+			/* reuse record with the same name, case sensitive */
+			int i = dc->ahash[fsdb_hash (aino->aname, true) & (dc->hashsize - 1)];
+			while (i >= 0) {
+				if (!_tcscmp (dc->anames[i], aino->aname)) {
+					aino->has_dbentry = 1;
+					aino->db_offset = i * FSDB_ENTRY_SIZE;
+					break;
+				}
+				i = dc->anext[i];
 			}
-			xfree (s);
-			i += 1 + 4 + 257 + 257 + 81;
 		}
 
 		if (! aino->has_dbentry) {
@@ -388,9 +522,17 @@ void fsdb_dir_writeback (a_inode *dir)
 		} else {
 			fseek (f, aino->db_offset, SEEK_SET);
 		}
-		write_aino (f, aino);
+		write_aino (f, aino, dc);
 	}
 	TRACE ((_T("end\n")));
 	fclose (f);
-	xfree (tmpbuf);
+	if (!dc)
+		return;
+	/* records are only rewritten in place or appended, keep the memory copy */
+	n = build_nname (dir->nname, FSDB_FILE);
+	if (my_stat (n, &st) && st.size == (uae_s64)dc->entries * FSDB_ENTRY_SIZE && fsdb_cache_index (dc))
+		fsdb_cache_setstat (dc, &st);
+	else
+		fsdb_dir_free (dir);
+	xfree (n);
 }
@@ -892,6 +892,7 @@ void video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h)
 						gb->height_redraw = h;
 						y1 = 0;
 						y2 = h;
+						picasso_invalidate(gb->monitor_id, 0, 0, vidinfo->maxwidth, vidinfo->maxheight);
 					}
 					for (int yy = y1; yy < y2 && yy < vidinfo->maxheight; yy++) {
 						uae_u8 *d = gb->gfxboard_surface + yy * vidinfo->rowbytes;
@@ -899,6 +900,9 @@ void video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h)
 						int ww = w > vidinfo->maxwidth ? vidinfo->maxwidth : w;
 						memcpy(d, s, ww * vidinfo->pixbytes);
 					}
+					if (y2 > y1) {
+						picasso_invalidate(gb->monitor_id, 0, y1, w > vidinfo->maxwidth ? vidinfo->maxwidth : w, y2 - y1);
+					}
 				}
 			}
 			if (gb->pcem_direct) {
@@ -84,6 +84,7 @@ struct hardfileprivdata {
 	bool directorydrive;
 };
 
+#define HFD_VHD_DIFF 6 // VHD disk type 4, renumbered to not clash with HFD_CHD_HD
 #define HFD_CHD_OTHER 5
 #define HFD_CHD_HD 4
 #define HFD_VHD_DYNAMIC 3
@@ -94,9 +95,10 @@ STATIC_INLINE uae_u32 gl (uae_u8 *p)
 	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
 }
 
-static uae_sem_t change_sem;
-
 static struct hardfileprivdata hardfpd[MAX_FILESYSTEM_UNITS];
+// Serializes I/O and media change of one unit, units run in parallel.
+// Kept outside hardfileprivdata because that gets cleared on thread start.
+static uae_sem_t unit_sem[MAX_FILESYSTEM_UNITS];
 
 static uae_u32 nscmd_cmd;
 
@@ -116,6 +118,10 @@ static int rl (uae_u8 *p)
 {
 	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3]);
 }
+static uae_u64 rq (uae_u8 *p)
+{
+	return ((uae_u64)(uae_u32)rl (p) << 32) | (uae_u32)rl (p + 4);
+}
 
 
 static void getchs2 (struct hardfiledata *hfd, int *cyl, int *cylsec, int *head, int *tracksec)
@@ -386,6 +392,8 @@ static uae_u32 get_filesys_version(uae_u8 *fs, int size)
 
 // hardware block size is always 256 or 512
 // filesystem block size can be 256, 512 or larger
+static void hdf_free_cache(struct hardfiledata *hfd);
+
 static void create_virtual_rdb (struct hardfiledata *hfd)
 {
 	uae_u8 *rdb, *part, *denv, *fs;
@@ -550,6 +558,8 @@ static void create_virtual_rdb (struct hardfiledata *hfd)
 	}
 
 	hfd->virtsize += size;
+	// offsets moved, drop lines cached by earlier raw reads
+	hdf_free_cache(hfd);
 }
 
 void hdf_hd_close (struct hd_hardfiledata *hfd)
@@ -594,6 +604,7 @@ int hdf_hd_open (struct hd_hardfiledata *hfd)
 		}
 	}
 	hfd->size = hfd->hfd.virtsize;
+	hfd->hfd.bcache_enabled = true;
 	return 1;
 }
 
@@ -614,24 +625,378 @@ static uae_u32 vhd_checksum (uae_u8 *p, int offset)
 static int hdf_write2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, uae_u32 *error);
 static int hdf_read2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, uae_u32 *error);
 
+/* Sector cache. Fixed size lines hashed by line number, clock eviction,
+ * write-through (cached lines are updated after the host write succeeded),
+ * multi-line read-ahead when the previous read ended where this one starts.
+ * Large transfers bypass the cache but still update cached lines.
+ * Allocated on first I/O after the unit started and only for image files:
+ * physical drives are cached by the host and get reopened on media change. */
+
+#define HDF_CACHE_LINE 16384
+#define HDF_CACHE_READAHEAD 8
+
+static void hdf_free_cache(struct hardfiledata *hfd)
+{
+	if (hfd->bcache_blocks && (hfd->bcache_hits || hfd->bcache_misses)) {
+		write_log(_T("HDF cache: %u hits, %u misses (%u%%), %u read-ahead\n"),
+			hfd->bcache_hits, hfd->bcache_misses,
+			(uae_u32)((uae_u64)hfd->bcache_hits * 100 / (hfd->bcache_hits + hfd->bcache_misses)),
+			hfd->bcache_readahead);
+	}
+	xfree(hfd->bcache_mem);
+	hfd->bcache_mem = NULL;
+	xfree(hfd->bcache_rabuf);
+	hfd->bcache_rabuf = NULL;
+	for (int i = 0; i < MAX_HDF_CACHE_BLOCKS; i++) {
+		hfd->bcache[i].valid = false;
+		hfd->bcache[i].data = NULL;
+	}
+	memset(hfd->bcache_hash, 0, sizeof hfd->bcache_hash);
+	hfd->bcache_blocks = 0;
+	hfd->bcache_started = false;
+}
+
 static void hdf_init_cache(struct hardfiledata *hfd)
 {
+	int blocks = currprefs.harddrive_cache_size * 1024 / HDF_CACHE_LINE;
+
+	hdf_free_cache(hfd);
+	hfd->bcache_hand = 0;
+	hfd->bcache_next = ~0ULL;
+	hfd->bcache_hits = hfd->bcache_misses = 0;
+	hfd->bcache_readahead = 0;
+	if (blocks > MAX_HDF_CACHE_BLOCKS)
+		blocks = MAX_HDF_CACHE_BLOCKS;
+	if (blocks < HDF_CACHE_READAHEAD * 2)
+		return;
+	hfd->bcache_mem = xcalloc(uae_u8, blocks * HDF_CACHE_LINE);
+	hfd->bcache_rabuf = xmalloc(uae_u8, HDF_CACHE_READAHEAD * HDF_CACHE_LINE);
+	if (!hfd->bcache_mem || !hfd->bcache_rabuf) {
+		hdf_free_cache(hfd);
+		return;
+	}
+	for (int i = 0; i < blocks; i++) {
+		hfd->bcache[i].data = hfd->bcache_mem + i * HDF_CACHE_LINE;
+	}
+	hfd->bcache_blocks = blocks;
+}
+
+// Called from the I/O path only, so the unit's own lock covers it.
+// Probes and not yet started units never set bcache_enabled.
+static bool hdf_start_cache(struct hardfiledata *hfd)
+{
+	if (!hfd->bcache_started && hfd->bcache_enabled) {
+		if (!(hfd->flags & HFD_FLAGS_REALDRIVE) && currprefs.harddrive_cache_size > 0)
+			hdf_init_cache(hfd);
+		hfd->bcache_started = true;
+	}
+	return hfd->bcache_blocks > 0;
+}
+
+static int hdf_cache_hash(uae_u64 block)
+{
+	return (int)(block ^ (block >> 9)) & (MAX_HDF_CACHE_HASH - 1);
+}
+
+// Hash chains store index + 1, 0 terminates.
+static struct hdf_cache *hdf_cache_lookup(struct hardfiledata *hfd, uae_u64 block)
+{
+	int idx = hfd->bcache_hash[hdf_cache_hash(block)];
+	while (idx) {
+		struct hdf_cache *hc = &hfd->bcache[idx - 1];
+		if (hc->block == block)
+			return hc;
+		idx = hc->hnext;
+	}
+	return NULL;
+}
+
+static struct hdf_cache *hdf_cache_find(struct hardfiledata *hfd, uae_u64 block)
+{
+	struct hdf_cache *hc = hdf_cache_lookup(hfd, block);
+	if (hc)
+		hc->ref = true;
+	return hc;
 }
-static void hdf_flush_cache(struct hardfiledata *hdf)
+
+static void hdf_cache_link(struct hardfiledata *hfd, struct hdf_cache *hc, uae_u64 block)
 {
+	int h = hdf_cache_hash(block);
+	hc->block = block;
+	hc->hnext = hfd->bcache_hash[h];
+	hfd->bcache_hash[h] = (int)(hc - hfd->bcache) + 1;
+	hc->valid = true;
+	hc->ref = true;
+}
+
+static void hdf_cache_unlink(struct hardfiledata *hfd, struct hdf_cache *hc)
+{
+	int idx = (int)(hc - hfd->bcache) + 1;
+	int *pp = &hfd->bcache_hash[hdf_cache_hash(hc->block)];
+	while (*pp) {
+		if (*pp == idx) {
+			*pp = hc->hnext;
+			break;
+		}
+		pp = &hfd->bcache[*pp - 1].hnext;
+	}
+	hc->valid = false;
+}
+
+// Clock: recently used lines get one more pass before they are reused.
+static struct hdf_cache *hdf_cache_evict(struct hardfiledata *hfd)
+{
+	for (;;) {
+		struct hdf_cache *hc = &hfd->bcache[hfd->bcache_hand];
+		if (++hfd->bcache_hand >= hfd->bcache_blocks)
+			hfd->bcache_hand = 0;
+		if (!hc->valid)
+			return hc;
+		if (!hc->ref) {
+			hdf_cache_unlink(hfd, hc);
+			return hc;
+		}
+		hc->ref = false;
+	}
+}
+
+// Load line 'block' and up to 'ahead' following uncached lines with one read.
+static struct hdf_cache *hdf_cache_fill(struct hardfiledata *hfd, uae_u64 block, int ahead)
+{
+	uae_u64 offset = block * HDF_CACHE_LINE;
+	uae_u32 error = 0;
+	int lines, len;
+
+	if (offset >= hfd->virtsize)
+		return NULL;
+	for (lines = 1; lines < ahead; lines++) {
+		if ((block + lines) * HDF_CACHE_LINE >= hfd->virtsize || hdf_cache_lookup(hfd, block + lines))
+			break;
+	}
+	len = lines * HDF_CACHE_LINE;
+	if (offset + len > hfd->virtsize)
+		len = (int)(hfd->virtsize - offset);
+	if (hdf_read2(hfd, hfd->bcache_rabuf, offset, len, &error) != len || error)
+		return NULL;
+	struct hdf_cache *first = NULL;
+	for (int i = 0; i < lines; i++) {
+		struct hdf_cache *hc = hdf_cache_evict(hfd);
+		hc->len = len - i * HDF_CACHE_LINE;
+		if (hc->len > HDF_CACHE_LINE)
+			hc->len = HDF_CACHE_LINE;
+		memcpy(hc->data, hfd->bcache_rabuf + i * HDF_CACHE_LINE, hc->len);
+		hdf_cache_link(hfd, hc, block + i);
+		if (!first)
+			first = hc;
+		else
+			hfd->bcache_readahead++;
+	}
+	return first;
+}
+
+// Copy between buffer and any cached lines that overlap offset/len.
+static void hdf_cache_overlap(struct hardfiledata *hfd, uae_u8 *buffer, uae_u64 offset, int len, bool towrite)
+{
+	uae_u64 last = (offset + len - 1) / HDF_CACHE_LINE;
+	for (uae_u64 block = offset / HDF_CACHE_LINE; block <= last; block++) {
+		struct hdf_cache *hc = hdf_cache_lookup(hfd, block);
+		if (!hc)
+			continue;
+		uae_u64 start = hc->block * HDF_CACHE_LINE;
+		uae_u64 end = start + hc->len;
+		if (end <= offset || start >= offset + len)
+			continue;
+		uae_u64 s = start > offset ? start : offset;
+		uae_u64 e = end < offset + len ? end : offset + len;
+		if (towrite) {
+			memcpy(hc->data + (s - start), buffer + (s - offset), (size_t)(e - s));
+		} else {
+			memcpy(buffer + (s - offset), hc->data + (s - start), (size_t)(e - s));
+		}
+	}
 }
 
 static int hdf_cache_read(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, uae_u32 *error)
 {
-	return hdf_read2(hfd, buffer, offset, len, error);
+	uae_u8 *p = (uae_u8*)buffer;
+	int got = 0;
+
+	if (len <= 0 || !hdf_start_cache(hfd))
+		return hdf_read2(hfd, buffer, offset, len, error);
+
+	bool sequential = offset == hfd->bcache_next;
+	hfd->bcache_next = offset + len;
+
+	if (len > hfd->bcache_blocks * HDF_CACHE_LINE / 4 || offset + len > hfd->virtsize) {
+		int v = hdf_read2(hfd, buffer, offset, len, error);
+		if (v > 0)
+			hdf_cache_overlap(hfd, p, offset, v, false);
+		return v;
+	}
+
+	while (len > 0) {
+		uae_u64 block = offset / HDF_CACHE_LINE;
+		int coffset = (int)(offset - block * HDF_CACHE_LINE);
+		struct hdf_cache *hc = hdf_cache_find(hfd, block);
+		if (hc) {
+			hfd->bcache_hits++;
+		} else {
+			hfd->bcache_misses++;
+			hc = hdf_cache_fill(hfd, block, sequential ? HDF_CACHE_READAHEAD : 1);
+			if (!hc) {
+				int v = hdf_read2(hfd, p, offset, len, error);
+				if (v <= 0)
+					return got ? got : v;
+				hdf_cache_overlap(hfd, p, offset, v, false);
+				return got + v;
+			}
+		}
+		int size = hc->len - coffset;
+		if (size > len)
+			size = len;
+		memcpy(p, hc->data + coffset, size);
+		p += size;
+		offset += size;
+		len -= size;
+		got += size;
+	}
+	return got;
 }
 
 static int hdf_cache_write(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, uae_u32 *error)
 {
-	return hdf_write2(hfd, buffer, offset, len, error);
+	uae_u8 *p = (uae_u8*)buffer;
+
+	if (len <= 0 || !hdf_start_cache(hfd))
+		return hdf_write2(hfd, buffer, offset, len, error);
+
+	int v = hdf_write2(hfd, buffer, offset, len, error);
+	// writes to virtual RDB are ignored, cached copy must not change either
+	uae_u64 skip = offset < hfd->virtual_size ? hfd->virtual_size - offset : 0;
+	if (v > 0 && skip < (uae_u64)v)
+		hdf_cache_overlap(hfd, p + skip, offset + skip, (int)(v - skip), true);
+	return v;
 }
 
-int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
+// Differencing VHD: sectors not present in the child come from the parent.
+// Parent can be anything hdf_open() accepts (raw, VHD, CHD, archive).
+
+#define VHD_PLAT_W2RU 0x57327275
+#define VHD_PLAT_W2KU 0x57326b75
+#define VHD_MAX_PARENT_DEPTH 16
+
+static int hdf_open2 (struct hardfiledata *hfd, const TCHAR *pname, int depth);
+
+static bool vhd_read_parent (struct hardfiledata *hfd, uae_u8 *dataptr, uae_u64 offset)
+{
+	uae_u32 error = 0;
+
+	if (!hfd->vhd_parent) {
+		memset (dataptr, 0, 512);
+		return true;
+	}
+	if (hdf_read (hfd->vhd_parent, dataptr, offset, 512, &error) != 512) {
+		write_log (_T("vhd_read: parent read error\n"));
+		return false;
+	}
+	return true;
+}
+
+static struct hardfiledata *vhd_try_parent (const TCHAR *path, uae_u64 size, const uae_u8 *uuid, int depth)
+{
+	struct hardfiledata *phfd;
+	uae_u8 footer[512];
+	uae_u32 error = 0;
+	static const uae_u8 nouuid[16] = { 0 };
+
+	if (!path[0] || !zfile_exists (path) || depth > VHD_MAX_PARENT_DEPTH)
+		return NULL;
+	phfd = xcalloc (struct hardfiledata, 1);
+	phfd->ci.readonly = true;
+	phfd->ci.blocksize = 512;
+	if (hdf_open2 (phfd, path, depth) > 0) {
+		// VHD parent must be the one the child was created from
+		if ((phfd->hfd_type == HFD_VHD_FIXED || phfd->hfd_type == HFD_VHD_DYNAMIC || phfd->hfd_type == HFD_VHD_DIFF) && memcmp (uuid, nouuid, 16) &&
+			(hdf_read_target (phfd, footer, phfd->vhd_footerblock, 512, &error) != 512 || memcmp (footer + 0x44, uuid, 16))) {
+			write_log (_T("VHD parent '%s' unique id does not match child\n"), path);
+		} else if (phfd->virtsize >= size) {
+			return phfd;
+		} else {
+			write_log (_T("VHD parent '%s' is smaller than child\n"), path);
+		}
+	}
+	hdf_close (phfd);
+	xfree (phfd);
+	return NULL;
+}
+
+static void vhd_utf16 (TCHAR *out, const uae_u8 *p, int len, bool be)
+{
+	int i;
+	for (i = 0; i < len / 2 && i < MAX_DPATH - 1; i++) {
+		uae_u16 c = be ? (p[i * 2] << 8) | p[i * 2 + 1] : (p[i * 2 + 1] << 8) | p[i * 2];
+		if (!c)
+			break;
+		out[i] = c;
+	}
+	out[i] = 0;
+}
+
+static bool vhd_open_parent (struct hardfiledata *hfd, const TCHAR *childpath, uae_u64 dynoffset, int depth)
+{
+	uae_u8 dh[1024];
+	uae_u8 loc[MAX_DPATH * 2];
+	TCHAR dir[MAX_DPATH], name[MAX_DPATH], path[MAX_DPATH];
+	uae_u32 error = 0;
+
+	if (hdf_read_target (hfd, dh, dynoffset, sizeof dh, &error) != sizeof dh)
+		return false;
+	_tcscpy (dir, childpath);
+	TCHAR *p = dir + _tcslen (dir);
+	while (p > dir && p[-1] != '\\' && p[-1] != '/')
+		p--;
+	*p = 0;
+	// parent locators first, then parent name relative to child
+	for (int i = 0; i <= 8 && !hfd->vhd_parent; i++) {
+		if (i < 8) {
+			uae_u8 *l = dh + 0x240 + i * 24;
+			uae_u32 code = gl (l);
+			uae_u32 len = gl (l + 8);
+			uae_u64 off = ((uae_u64)gl (l + 16) << 32) | gl (l + 20);
+			if (code != VHD_PLAT_W2RU && code != VHD_PLAT_W2KU)
+				continue;
+			if (!len || len > sizeof loc || off + len > hfd->physsize)
+				continue;
+			if (hdf_read_target (hfd, loc, off, len, &error) != len)
+				continue;
+			vhd_utf16 (name, loc, len, false);
+			if (code == VHD_PLAT_W2RU) {
+				TCHAR *n = name;
+				if (n[0] == '.' && (n[1] == '\\' || n[1] == '/'))
+					n += 2;
+				_stprintf (path, _T("%s%s"), dir, n);
+			} else {
+				_tcscpy (path, name);
+			}
+		} else {
+			vhd_utf16 (name, dh + 0x40, 512, true);
+			if (_tcschr (name, '\\') || _tcschr (name, '/'))
+				_tcscpy (path, name);
+			else
+				_stprintf (path, _T("%s%s"), dir, name);
+		}
+		hfd->vhd_parent = vhd_try_parent (path, hfd->virtsize, dh + 0x28, depth + 1);
+		if (hfd->vhd_parent)
+			write_log (_T("VHD parent '%s'\n"), path);
+	}
+	if (!hfd->vhd_parent) {
+		write_log (_T("VHD differencing image: parent not found\n"));
+		return false;
+	}
+	return true;
+}
+
+static int hdf_open2 (struct hardfiledata *hfd, const TCHAR *pname, int depth)
 {
 	int ret;
 	uae_u8 tmp[512], tmp2[512];
@@ -707,7 +1072,9 @@ int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 	if ((v >> 16) != 1)
 		goto nonvhd;
 	hfd->hfd_type = gl (tmp + 8 + 4 + 4 + 8 + 4 + 4 + 4 + 4 + 8 + 8 + 4);
-	if (hfd->hfd_type != HFD_VHD_FIXED && hfd->hfd_type != HFD_VHD_DYNAMIC)
+	if (hfd->hfd_type == 4)
+		hfd->hfd_type = HFD_VHD_DIFF;
+	if (hfd->hfd_type != HFD_VHD_FIXED && hfd->hfd_type != HFD_VHD_DYNAMIC && hfd->hfd_type != HFD_VHD_DIFF)
 		goto nonvhd;
 	v = gl (tmp + 8 + 4 + 4 + 8 + 4 + 4 + 4 + 4 + 8 + 8 + 4 + 4);
 	if (v == 0)
@@ -721,9 +1088,9 @@ int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 	hfd->vhd_footerblock = hfd->physsize - 512;
 	hfd->virtsize = (uae_u64)(gl (tmp + 8 + 4 + 4 + 8 + 4 + 4 +4 + 4 + 8)) << 32;
 	hfd->virtsize |= gl (tmp + 8 + 4 + 4 + 8 + 4 + 4 +4 + 4 + 8 + 4);
-	if (hfd->hfd_type == HFD_VHD_DYNAMIC) {
-		uae_u32 size;
-		hfd->vhd_bamoffset = gl (tmp + 8 + 4 + 4 + 4);
+	if (hfd->hfd_type == HFD_VHD_DYNAMIC || hfd->hfd_type == HFD_VHD_DIFF) {
+		uae_u32 size, dynoffset;
+		hfd->vhd_bamoffset = dynoffset = gl (tmp + 8 + 4 + 4 + 4);
 		if (hfd->vhd_bamoffset == 0 || hfd->vhd_bamoffset >= hfd->physsize)
 			goto end;
 		if (hdf_read_target (hfd, tmp, hfd->vhd_bamoffset, 512, &error) != 512)
@@ -744,11 +1111,12 @@ int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 		hfd->vhd_sectormap = xmalloc (uae_u8, 512);
 		hfd->vhd_sectormapblock = -1;
 		hfd->vhd_bitmapsize = ((hfd->vhd_blocksize / (8 * 512)) + 511) & ~511;
+		if (hfd->hfd_type == HFD_VHD_DIFF && !vhd_open_parent (hfd, filepath, dynoffset, depth))
+			goto end;
 	}
 	write_log (_T("HDF is VHD %s image, virtual size=%lldK (%llx %lld)\n"),
-		hfd->hfd_type == HFD_VHD_FIXED ? _T("fixed") : _T("dynamic"),
+		hfd->hfd_type == HFD_VHD_FIXED ? _T("fixed") : (hfd->hfd_type == HFD_VHD_DIFF ? _T("differencing") : _T("dynamic")),
 		hfd->virtsize / 1024, hfd->virtsize, hfd->virtsize);
-	hdf_init_cache (hfd);
 	return 1;
 nonvhd:
 	hfd->hfd_type = 0;
@@ -757,6 +1125,10 @@ end:
 	hdf_close_target (hfd);
 	return 0;
 }
+int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
+{
+	return hdf_open2 (hfd, pname, 0);
+}
 int hdf_open (struct hardfiledata *hfd)
 {
 	int v = hdf_open (hfd, NULL);
@@ -769,8 +1141,13 @@ int hdf_open (struct hardfiledata *hfd)
 
 void hdf_close (struct hardfiledata *hfd)
 {
-	hdf_flush_cache (hfd);
+	hdf_free_cache (hfd);
 	hdf_close_target (hfd);
+	if (hfd->vhd_parent) {
+		hdf_close (hfd->vhd_parent);
+		xfree (hfd->vhd_parent);
+		hfd->vhd_parent = NULL;
+	}
 #ifdef WITH_CHD
 	if (hfd->hfd_type == HFD_CHD_OTHER) {
 		chd_file *cf = (chd_file*)hfd->chd_handle;
@@ -818,7 +1195,8 @@ static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_
 		uae_u32 bamoffset = (uae_u32)((offset / hfd->vhd_blocksize) * 4 + hfd->vhd_bamoffset);
 		uae_u32 sectoroffset = gl (hfd->vhd_header + bamoffset);
 		if (sectoroffset == 0xffffffff) {
-			memset (dataptr, 0, 512);
+			if (!vhd_read_parent (hfd, dataptr, offset))
+				return read;
 			read += 512;
 		} else {
 			int bitmapoffsetbits;
@@ -846,8 +1224,8 @@ static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_
 					write_log (_T("vhd_read: data read error\n"));
 					return read;
 				}
-			} else {
-				memset (dataptr, 0, 512);
+			} else if (!vhd_read_parent (hfd, dataptr, offset)) {
+				return read;
 			}
 			read += 512;
 		}
@@ -954,15 +1332,34 @@ static uae_u64 vhd_write (struct hardfiledata *hfd, void *v, uae_u64 offset, uae
 }
 
 
-int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
+static void vhd_put_utf16 (uae_u8 *p, const TCHAR *s, int max, bool be)
+{
+	for (int i = 0; s[i] && i < max / 2; i++) {
+		uae_u16 c = s[i];
+		p[i * 2 + (be ? 0 : 1)] = c >> 8;
+		p[i * 2 + (be ? 1 : 0)] = (uae_u8)c;
+	}
+}
+
+static void vhd_put_locator (uae_u8 *l, uae_u32 code, uae_u32 space, uae_u32 len, uae_u64 offset)
+{
+	wl (l + 0, code);
+	wl (l + 4, space);
+	wl (l + 8, len);
+	wl (l + 16, (uae_u32)(offset >> 32));
+	wl (l + 20, (uae_u32)offset);
+}
+
+static int vhd_create2 (const TCHAR *name, uae_u64 size, uae_u32 dostype, const TCHAR *parentname, const uae_u8 *parentfooter)
 {
 	struct hardfiledata hfd;
 	struct zfile *zf;
 	uae_u8 *b;
 	int cyl, cylsec, head, tracksec;
-	uae_u32 crc, blocksize, batsize, batentrysize;
+	uae_u32 crc, blocksize, batsize, batentrysize, locsize;
 	int ret, i;
 	time_t tm;
+	TCHAR relname[MAX_DPATH];
 
 	if (size >= (uae_u64)10 * 1024 * 1024 * 1024)
 		blocksize = 2 * 1024 * 1024;
@@ -973,13 +1370,22 @@ int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 	batsize *= 4;
 	batsize += 511;
 	batsize &= ~511;
+	// differencing: W2ku (absolute) and W2ru (relative) locators after BAT
+	locsize = 0;
+	if (parentname) {
+		const TCHAR *p = parentname + _tcslen (parentname);
+		while (p > parentname && p[-1] != '\\' && p[-1] != '/')
+			p--;
+		_stprintf (relname, _T(".\\%s"), p);
+		locsize = (uae_u32)((_tcslen (parentname) * 2 + 511) & ~511);
+	}
 	ret = 0;
 	b = NULL;
 	zf = zfile_fopen (name, _T("wb"), 0);
 	if (!zf)
 		goto end;
-	b = xcalloc (uae_u8, 512 + 1024 + batsize + 512);
-	if (zfile_fwrite (b, 512 + 1024 + batsize + 512, 1, zf) != 1)
+	b = xcalloc (uae_u8, 512 + 1024 + batsize + 2 * locsize + 512);
+	if (zfile_fwrite (b, 512 + 1024 + batsize + 2 * locsize + 512, 1, zf) != 1)
 		goto end;
 
 	memset (&hfd, 0, sizeof hfd);
@@ -1016,7 +1422,7 @@ int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 	// sectors per track
 	b[0x3b] = tracksec;
 	// disk type
-	b[0x3c + 3] = HFD_VHD_DYNAMIC;
+	b[0x3c + 3] = parentname ? 4 : HFD_VHD_DYNAMIC;
 	get_guid_target (b + 0x44);
 	crc = vhd_checksum (b, -1);
 	b[0x40] = crc >> 24;
@@ -1028,7 +1434,7 @@ int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 	zfile_fseek (zf, 0, SEEK_SET);
 	zfile_fwrite (b, 512, 1, zf);
 	// write footer
-	zfile_fseek (zf, 512 + 1024 + batsize, SEEK_SET);
+	zfile_fseek (zf, 512 + 1024 + batsize + 2 * locsize, SEEK_SET);
 	zfile_fwrite (b, 512, 1, zf);
 
 	// dynamic disk header
@@ -1051,6 +1457,18 @@ int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 	b[0x21] = blocksize >> 16;
 	b[0x22] = blocksize >>  8;
 	b[0x23] = blocksize >>  0;
+	if (parentname) {
+		const TCHAR *p = relname + 2;
+		// parent unicode name (big endian)
+		vhd_put_utf16 (b + 0x40, p, 512, true);
+		if (parentfooter) {
+			// parent unique id and time stamp, from parent footer
+			memcpy (b + 0x28, parentfooter + 0x44, 16);
+			memcpy (b + 0x38, parentfooter + 0x18, 4);
+		}
+		vhd_put_locator (b + 0x240, VHD_PLAT_W2KU, locsize / 512, (uae_u32)_tcslen (parentname) * 2, 512 + 1024 + batsize);
+		vhd_put_locator (b + 0x240 + 24, VHD_PLAT_W2RU, locsize / 512, (uae_u32)_tcslen (relname) * 2, 512 + 1024 + batsize + locsize);
+	}
 	crc = vhd_checksum (b, -1);
 	b[0x24] = crc >> 24;
 	b[0x25] = crc >> 16;
@@ -1066,6 +1484,13 @@ int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 	memset (b, 0xff, batentrysize * 4);
 	zfile_fwrite (b, batsize, 1, zf);
 
+	if (parentname) {
+		memset (b, 0, 2 * locsize);
+		vhd_put_utf16 (b, parentname, locsize, false);
+		vhd_put_utf16 (b + locsize, relname, locsize, false);
+		zfile_fwrite (b, 2 * locsize, 1, zf);
+	}
+
 	zfile_fclose (zf);
 	zf = NULL;
 
@@ -1089,6 +1514,37 @@ end:
 	return ret;
 }
 
+int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
+{
+	return vhd_create2 (name, size, dostype, NULL, NULL);
+}
+
+// Empty differencing image on top of parentname, all reads initially go to parent.
+int vhd_create_differencing (const TCHAR *name, const TCHAR *parentname)
+{
+	struct hardfiledata phfd;
+	TCHAR ppath[MAX_DPATH];
+	uae_u8 footer[512];
+	bool vhdparent;
+	uae_u32 error = 0;
+	uae_u64 size;
+
+	_tcscpy (ppath, parentname);
+	fullpath (ppath, sizeof ppath / sizeof (TCHAR), false);
+	memset (&phfd, 0, sizeof phfd);
+	phfd.ci.readonly = true;
+	phfd.ci.blocksize = 512;
+	if (hdf_open (&phfd, ppath) <= 0) {
+		write_log (_T("vhd_create_differencing: can't open parent '%s'\n"), ppath);
+		return 0;
+	}
+	size = phfd.virtsize;
+	vhdparent = (phfd.hfd_type == HFD_VHD_FIXED || phfd.hfd_type == HFD_VHD_DYNAMIC || phfd.hfd_type == HFD_VHD_DIFF) &&
+		hdf_read_target (&phfd, footer, phfd.vhd_footerblock, 512, &error) == 512;
+	hdf_close (&phfd);
+	return vhd_create2 (name, size, 0, ppath, vhdparent ? footer : NULL);
+}
+
 static int hdf_read2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, uae_u32 *error)
 {
 	int ret = 0, extra = 0;
@@ -1110,7 +1566,7 @@ static int hdf_read2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
 	}
 	offset -= hfd->virtual_size;
 
-	if (hfd->hfd_type == HFD_VHD_DYNAMIC)
+	if (hfd->hfd_type == HFD_VHD_DYNAMIC || hfd->hfd_type == HFD_VHD_DIFF)
 		ret = (int)vhd_read (hfd, buffer, offset, len);
 	else if (hfd->hfd_type == HFD_VHD_FIXED)
 		ret = hdf_read_target (hfd, buffer, offset + 512, len, error);
@@ -1168,7 +1624,7 @@ static int hdf_write2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, in
 	}
 	offset -= hfd->virtual_size;
 
-	if (hfd->hfd_type == HFD_VHD_DYNAMIC)
+	if (hfd->hfd_type == HFD_VHD_DYNAMIC || hfd->hfd_type == HFD_VHD_DIFF)
 		ret = (int)vhd_write(hfd, buffer, offset, len);
 	else if (hfd->hfd_type == HFD_VHD_FIXED)
 		ret = hdf_write_target(hfd, buffer, offset + 512, len, error);
@@ -1327,23 +1783,40 @@ static uae_u64 cmd_readx(struct hardfiledata *hfd, uae_u8 *dataptr, uae_u64 offs
 	gui_flicker_led(LED_HD, hfd->unitnum, 1);
 	return hdf_read(hfd, dataptr, offset, (int)len, error);
 }
+// Direct trap mode: background thread can access Amiga RAM directly too.
+static uae_u8 *cmd_xlate(TrapContext *ctx, uaecptr dataptr, uae_u64 len)
+{
+	if ((ctx && trap_is_indirect()) || !real_address_allowed())
+		return NULL;
+	addrbank *bank_data = &get_mem_bank (dataptr);
+	if (!bank_data || !bank_data->check(dataptr, (uae_u32)len))
+		return NULL;
+	return bank_data->xlateaddr(dataptr);
+}
+
+// Indirect transfers: one host I/O per CMD_BOUNCE_SIZE, trap layer splits further.
+#define CMD_BOUNCE_SIZE (256 * 1024)
+
 static uae_u64 cmd_read(TrapContext *ctx, struct hardfiledata *hfd, uaecptr dataptr, uae_u64 offset, uae_u64 len, uae_u32 *error)
 {
 	if (!len || len > INT_MAX)
 		return 0;
-	if (!ctx && real_address_allowed()) {
-		addrbank *bank_data = &get_mem_bank (dataptr);
-		if (!bank_data)
-			return 0;
-		if (bank_data->check(dataptr, (uae_u32)len)) {
-			uae_u8 *buffer = bank_data->xlateaddr(dataptr);
-			return cmd_readx(hfd, buffer, offset, (uae_u32)len, error);
+	uae_u8 *buffer = cmd_xlate(ctx, dataptr, len);
+	if (buffer)
+		return cmd_readx(hfd, buffer, offset, (uae_u32)len, error);
+	int total = 0;
+	uae_u8 sbuf[RTAREA_TRAP_DATA_EXTRA_SIZE];
+	int max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
+	uae_u8 *buf = sbuf;
+	if (len > max) {
+		max = (int)(len > CMD_BOUNCE_SIZE ? CMD_BOUNCE_SIZE : len) & ~511;
+		buf = xmalloc(uae_u8, max);
+		if (!buf) {
+			buf = sbuf;
+			max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
 		}
 	}
-	int total = 0;
 	while (len > 0) {
-		uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
-		int max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
 		int size = (int)(len > max ? max : len);
 		if (cmd_readx(hfd, buf, offset, size, error) != size)
 			break;
@@ -1353,6 +1826,8 @@ static uae_u64 cmd_read(TrapContext *ctx, struct hardfiledata *hfd, uaecptr data
 		len -= size;
 		total += size;
 	}
+	if (buf != sbuf)
+		xfree(buf);
 	return total;
 }
 static uae_u64 cmd_writex(struct hardfiledata *hfd, uae_u8 *dataptr, uae_u64 offset, uae_u64 len, uae_u32 *error)
@@ -1368,19 +1843,22 @@ static uae_u64 cmd_write(TrapContext *ctx, struct hardfiledata *hfd, uaecptr dat
 {
 	if (!len || len > INT_MAX)
 		return 0;
-	if (!ctx && real_address_allowed()) {
-		addrbank *bank_data = &get_mem_bank (dataptr);
-		if (!bank_data)
-			return 0;
-		if (bank_data->check(dataptr, (uae_u32)len)) {
-			uae_u8 *buffer = bank_data->xlateaddr(dataptr);
-			return cmd_writex(hfd, buffer, offset, len, error);
+	uae_u8 *buffer = cmd_xlate(ctx, dataptr, len);
+	if (buffer)
+		return cmd_writex(hfd, buffer, offset, len, error);
+	int total = 0;
+	uae_u8 sbuf[RTAREA_TRAP_DATA_EXTRA_SIZE];
+	int max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
+	uae_u8 *buf = sbuf;
+	if (len > max) {
+		max = (int)(len > CMD_BOUNCE_SIZE ? CMD_BOUNCE_SIZE : len) & ~511;
+		buf = xmalloc(uae_u8, max);
+		if (!buf) {
+			buf = sbuf;
+			max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
 		}
 	}
-	int total = 0;
 	while (len > 0) {
-		uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
-		int max = RTAREA_TRAP_DATA_EXTRA_SIZE & ~511;
 		int size = (int)(len > max ? max : len);
 		trap_get_bytes(ctx, buf, dataptr, size);
 		if (cmd_writex(hfd, buf, offset, size, error) != size)
@@ -1390,6 +1868,8 @@ static uae_u64 cmd_write(TrapContext *ctx, struct hardfiledata *hfd, uaecptr dat
 		len -= size;
 		total += size;
 	}
+	if (buf != sbuf)
+		xfree(buf);
 	return total;
 }
 
@@ -1496,6 +1976,45 @@ static uae_u64 get_scsi_6_offset(struct hardfiledata *hfd, struct hd_hardfiledat
 	return offset;
 }
 
+// READ/WRITE (6/10/12/16) CDB decode: 1 = read, 2 = write, 0 = something else
+static int scsi_hd_rw_decode(struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, uae_u8 *cmdbuf, bool sasi, uae_u64 *current_lba, uae_u64 *lba, uae_u64 *blocks)
+{
+	int rw;
+	switch (cmdbuf[0])
+	{
+	case 0x08: /* READ (6) */
+	case 0x0a: /* WRITE (6) */
+		rw = cmdbuf[0] == 0x08 ? 1 : 2;
+		*lba = get_scsi_6_offset(hfd, hdhfd, cmdbuf, current_lba);
+		*blocks = cmdbuf[4] ? cmdbuf[4] : 256;
+		return rw;
+	}
+	if (sasi)
+		return 0;
+	switch (cmdbuf[0])
+	{
+	case 0x28: /* READ (10) */
+	case 0x2a: /* WRITE (10) */
+		rw = cmdbuf[0] == 0x28 ? 1 : 2;
+		*lba = (uae_u32)rl (cmdbuf + 2);
+		*blocks = rl (cmdbuf + 7 - 2) & 0xffff;
+		return rw;
+	case 0xa8: /* READ (12) */
+	case 0xaa: /* WRITE (12) */
+		rw = cmdbuf[0] == 0xa8 ? 1 : 2;
+		*lba = (uae_u32)rl (cmdbuf + 2);
+		*blocks = (uae_u32)rl (cmdbuf + 6);
+		return rw;
+	case 0x88: /* READ (16) */
+	case 0x8a: /* WRITE (16) */
+		rw = cmdbuf[0] == 0x88 ? 1 : 2;
+		*lba = rq (cmdbuf + 2);
+		*blocks = (uae_u32)rl (cmdbuf + 10);
+		return rw;
+	}
+	return 0;
+}
+
 int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, uae_u8 *cmdbuf, int scsi_cmd_len,
 	uae_u8 *scsi_data, int *data_len, uae_u8 *r, int *reply_len, uae_u8 *s, int *sense_len)
 {
@@ -1508,7 +2027,7 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 	int chkerr;
 	int scsi_len = -1;
 	int status = 0;
-	int lun;
+	int lun, rw;
 	uae_u8 cmd;
 	bool sasi = hfd->ci.unit_feature_level >= HD_LEVEL_SASI && hfd->ci.unit_feature_level <= HD_LEVEL_SASI_ENHANCED;
 	bool sasie = hfd->ci.unit_feature_level == HD_LEVEL_SASI_ENHANCED;
@@ -1548,6 +2067,36 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 		goto scsi_done;
 	}
 
+	/* READ/WRITE first: skips the SASI command scan and the switch below */
+	rw = scsi_hd_rw_decode(hfd, hdhfd, cmdbuf, sasi || omti, &current_lba, &offset, &len);
+	if (rw) {
+		if (hfd->unit_stopped)
+			goto notready;
+		if (nodisk (hfd))
+			goto nodisk;
+		if (rw == 2 && is_writeprotected(hfd))
+			goto readprot;
+		if (offset == ~0) {
+			chkerr = 1;
+			goto checkfail;
+		}
+		current_lba = offset;
+		offset *= hfd->ci.blocksize;
+		len *= hfd->ci.blocksize;
+		chkerr = checkbounds(hfd, offset, len, rw);
+		if (chkerr)
+			goto checkfail;
+		if (rw == 1)
+			scsi_len = (uae_u32)cmd_readx(hfd, scsi_data, offset, len, &error);
+		else
+			scsi_len = (uae_u32)cmd_writex(hfd, scsi_data, offset, len, &error);
+		if (error) {
+			chkerr = rw;
+			goto checkfail;
+		}
+		goto scsi_done;
+	}
+
 	if (sasi || omti) {
 		int i;
 		for (i = 0; sasi_commands[i] != 0xff; i++) {
@@ -1674,6 +2223,7 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 	}
 
 	if (hfd->unit_stopped) {
+notready:
 		status = 2; /* CHECK CONDITION */
 		s[0] = 0x70;
 		s[2] = 2; /* NOT READY */
@@ -1755,29 +2305,6 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 			goto checkfail;
 		scsi_len = 0;
 		break;
-	case 0x08: /* READ (6) */
-		if (nodisk (hfd))
-			goto nodisk;
-		offset = get_scsi_6_offset(hfd, hdhfd, cmdbuf, &current_lba);
-		if (offset == ~0) {
-			chkerr = 1;
-			goto checkfail;
-		}
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = cmdbuf[4];
-		if (!len)
-			len = 256;
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 1);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_readx(hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 1;
-			goto checkfail;
-		}
-		break;
 	case 0x0e: /* READ SECTOR BUFFER */
 		len = hfd->ci.blocksize;
 		scsi_len = (int)len;
@@ -1793,31 +2320,6 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 			len = sizeof(hfd->sector_buffer);
 		memcpy(hfd->sector_buffer, scsi_data, (size_t)len);
 		break;
-	case 0x0a: /* WRITE (6) */
-		if (nodisk (hfd))
-			goto nodisk;
-		if (is_writeprotected(hfd))
-			goto readprot;
-		offset = get_scsi_6_offset(hfd, hdhfd, cmdbuf, &current_lba);
-		if (offset == ~0) {
-			chkerr = 1;
-			goto checkfail;
-		}
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = cmdbuf[4];
-		if (!len)
-			len = 256;
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 2);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_writex(hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 2;
-			goto checkfail;
-		}
-		break;
 	case 0x55: // MODE SELECT(10)
 	case 0x15: // MODE SELECT(6)
 		{
@@ -2067,42 +2569,6 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 			goto checkfail;
 		scsi_len = 0;
 		break;
-	case 0x28: /* READ (10) */
-		if (nodisk (hfd))
-			goto nodisk;
-		offset = rl (cmdbuf + 2);
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = rl (cmdbuf + 7 - 2) & 0xffff;
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 1);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_readx(hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 1;
-			goto checkfail;
-		}
-		break;
-	case 0x2a: /* WRITE (10) */
-		if (nodisk (hfd))
-			goto nodisk;
-		if (is_writeprotected(hfd))
-			goto readprot;
-		offset = rl (cmdbuf + 2);
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = rl (cmdbuf + 7 - 2) & 0xffff;
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 2);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_writex(hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 2;
-			goto checkfail;
-		}
-		break;
 	case 0x2f: /* VERIFY (10) */
 		{
 			int bytchk = cmdbuf[1] & 2;
@@ -2142,42 +2608,6 @@ int scsi_hd_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, ua
 			goto nodisk;
 		scsi_len = 0;
 		break;
-	case 0xa8: /* READ (12) */
-		if (nodisk (hfd))
-			goto nodisk;
-		offset = rl (cmdbuf + 2);
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = rl (cmdbuf + 6);
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 1);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_readx(hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 1;
-			goto checkfail;
-		}
-		break;
-	case 0xaa: /* WRITE (12) */
-		if (nodisk (hfd))
-			goto nodisk;
-		if (is_writeprotected(hfd))
-			goto readprot;
-		offset = rl (cmdbuf + 2);
-		current_lba = offset;
-		offset *= hfd->ci.blocksize;
-		len = rl (cmdbuf + 6);
-		len *= hfd->ci.blocksize;
-		chkerr = checkbounds(hfd, offset, len, 2);
-		if (chkerr)
-			goto checkfail;
-		scsi_len = (uae_u32)cmd_writex (hfd, scsi_data, offset, len, &error);
-		if (error) {
-			chkerr = 2;
-			goto checkfail;
-		}
-		break;
 	case 0x37: /* READ DEFECT DATA */
 		if (nodisk (hfd))
 			goto nodisk;
@@ -2408,7 +2838,7 @@ void hardfile_send_disk_change (struct hardfiledata *hfd, bool insert)
 {
 	int newstate = insert ? 0 : 1;
 
-	uae_sem_wait (&change_sem);
+	uae_sem_wait (&unit_sem[hfd->unitnum]);
 	hardfpd[hfd->unitnum].changenum++;
 	write_log (_T("uaehf.device:%d media status=%d changenum=%d\n"), hfd->unitnum, insert, hardfpd[hfd->unitnum].changenum);
 	hfd->drive_empty = newstate;
@@ -2421,7 +2851,7 @@ void hardfile_send_disk_change (struct hardfiledata *hfd, bool insert)
 	}
 	if (hardfpd[hfd->unitnum].changeint)
 		uae_Cause (hardfpd[hfd->unitnum].changeint);
-	uae_sem_post (&change_sem);
+	uae_sem_post (&unit_sem[hfd->unitnum]);
 }
 
 void hardfile_do_disk_change (struct uaedev_config_data *uci, bool insert)
@@ -2569,6 +2999,7 @@ static uae_u32 REGPARAM2 hardfile_open (TrapContext *ctx)
 			} else {
 				if ((hfd->handle_valid || hfd->drive_empty) && start_thread(ctx, unit)) {
 					hfpd->directorydrive = false;
+					hfd->bcache_enabled = true;
 					trap_put_word(ctx, hfpd->base + 32, trap_get_word(ctx, hfpd->base + 32) + 1);
 					trap_put_long(ctx, ioreq + 24, unit); /* io_Unit */
 					trap_put_byte(ctx, ioreq + 31, 0); /* io_Error */
@@ -3063,6 +3494,7 @@ static uae_u32 REGPARAM2 hardfile_beginio (TrapContext *ctx)
 static void hardfile_thread (void *devs)
 {
 	struct hardfileprivdata *hfpd = (struct hardfileprivdata*)devs;
+	int unit = (int)(hfpd - &hardfpd[0]);
 
 	uae_set_thread_priority (NULL, 1);
 	hfpd->thread_running = 1;
@@ -3071,13 +3503,13 @@ static void hardfile_thread (void *devs)
 		TrapContext *ctx = (TrapContext*)read_comm_pipe_pvoid_blocking(&hfpd->requests);
 		uae_u8  *iobuf = (uae_u8*)read_comm_pipe_pvoid_blocking(&hfpd->requests);
 		uaecptr request = (uaecptr)read_comm_pipe_u32_blocking (&hfpd->requests);
-		uae_sem_wait (&change_sem);
+		uae_sem_wait (&unit_sem[unit]);
 		if (!request) {
 			hfpd->thread_running = 0;
 			uae_sem_post (&hfpd->sync_sem);
-			uae_sem_post (&change_sem);
+			uae_sem_post (&unit_sem[unit]);
 			return;
-		} else if (hardfile_do_io(ctx, get_hardfile_data_controller((int)(hfpd - &hardfpd[0])), hfpd, iobuf, request) == 0) {
+		} else if (hardfile_do_io(ctx, get_hardfile_data_controller(unit), hfpd, iobuf, request) == 0) {
 			put_byte_host(iobuf + 30, get_byte_host(iobuf + 30) & ~1);
 			trap_put_bytes(ctx, iobuf + 8, request + 8, 48 - 8);
 			release_async_request(hfpd, request);
@@ -3087,7 +3519,7 @@ static void hardfile_thread (void *devs)
 			trap_put_bytes(ctx, iobuf + 8, request + 8, 48 - 8);
 		}
 		trap_background_set_complete(ctx);
-		uae_sem_post (&change_sem);
+		uae_sem_post (&unit_sem[unit]);
 	}
 }
 
@@ -3115,7 +3547,8 @@ void hardfile_install (void)
 	uae_u32 initcode, openfunc, closefunc, expungefunc;
 	uae_u32 beginiofunc, abortiofunc;
 
-	uae_sem_init (&change_sem, 0, 1);
+	for (int i = 0; i < MAX_FILESYSTEM_UNITS; i++)
+		uae_sem_init (&unit_sem[i], 0, 1);
 
 	ROM_hardfile_resname = ds (currprefs.uaescsidevmode == 1 ? _T("scsi.device") : _T("uaehf.device"));
 	ROM_hardfile_resid = ds (_T("UAE hardfile.device 0.6"));
@@ -6,4 +6,8 @@
 int isamigatrack (uae_u16 *amigamfmbuffer, uae_u8 *mfmdata, int len, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsize);
 int ispctrack (uae_u16 *amigamfmbuffer, uae_u8 *mfmdata, int len, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsize);
 
+uae_u32 mfm_decode_block (const uae_u16 *mbuf, int shift, uae_u8 *dst, int words);
+void mfm_encode_block (const uae_u8 *src, uae_u16 *dst, int words);
+void mfm_clockbits (uae_u16 *mfm, int words);
+
 #endif /* UAE_DISKUTIL_H */
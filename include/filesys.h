@@ -14,17 +14,17 @@
 
 struct hardfilehandle;
 
-#define MAX_HDF_CACHE_BLOCKS 128
+#define MAX_HDF_CACHE_BLOCKS 256
+#define MAX_HDF_CACHE_HASH 512
 #define MAX_SCSI_SENSE 36
 struct hdf_cache
 {
 	bool valid;
+	bool ref;
 	uae_u8 *data;
 	uae_u64 block;
-	bool dirty;
-	int readcount;
-	int writecount;
-	time_t lastaccess;
+	int len;
+	int hnext;
 };
 
 struct hardfiledata {
@@ -61,6 +61,7 @@ struct hardfiledata {
     uae_u64 vhd_sectormapblock;
     uae_u32 vhd_bitmapsize;
     uae_u64 vhd_footerblock;
+    struct hardfiledata *vhd_parent;
 
 	void *chd_handle;
 
@@ -68,6 +69,15 @@ struct hardfiledata {
     TCHAR *emptyname;
 
 	struct hdf_cache bcache[MAX_HDF_CACHE_BLOCKS];
+	int bcache_blocks;
+	int bcache_hash[MAX_HDF_CACHE_HASH];
+	int bcache_hand;
+	bool bcache_enabled;
+	bool bcache_started;
+	uae_u64 bcache_next;
+	uae_u8 *bcache_mem;
+	uae_u8 *bcache_rabuf;
+	uae_u32 bcache_hits, bcache_misses, bcache_readahead;
 	uae_u8 scsi_sense[MAX_SCSI_SENSE];
 	uae_u8 sector_buffer[512];
 	uae_u8 identity[512];
@@ -145,6 +155,7 @@ int hdf_hd_open(struct hd_hardfiledata *hfd);
 
 
 extern int vhd_create (const TCHAR *name, uae_u64 size, uae_u32);
+extern int vhd_create_differencing (const TCHAR *name, const TCHAR *parentname);
 
 extern int hdf_init_target (void);
 extern int hdf_open_target (struct hardfiledata *hfd, const TCHAR *name);
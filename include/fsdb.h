@@ -78,6 +78,15 @@ typedef struct a_inode_struct {
     /* This a_inode's relatives in the directory structure.  */
     struct a_inode_struct *parent;
     struct a_inode_struct *child, *sibling;
+    /* Hash chains: unit uniq table, parent's aname and nname indexes.  */
+    struct a_inode_struct *uniq_next, *aname_next, *nname_next;
+    /* Name indexes of a large directory (aname buckets followed by
+     * nname buckets), NULL for small directories.  */
+    struct a_inode_struct **child_hash;
+    unsigned int child_hash_size;
+    unsigned int child_count;
+    /* In-memory copy of this directory's fsdb file.  */
+    struct fsdb_dircache *dbcache;
     /* AmigaOS name, and host OS name.  The host OS name is a full path, the
      * AmigaOS name is relative to the parent.  */
     TCHAR *aname;
@@ -128,11 +137,13 @@ extern TCHAR *build_aname (const TCHAR *d, const TCHAR *n);
 extern void fsdb_clean_dir (a_inode *);
 extern TCHAR *fsdb_search_dir (const TCHAR *dirname, TCHAR *rel, TCHAR **relalt);
 extern void fsdb_dir_writeback (a_inode *);
+extern void fsdb_dir_free (a_inode *);
 extern int fsdb_used_as_nname (a_inode *base, const TCHAR *);
 extern a_inode *fsdb_lookup_aino_aname (a_inode *base, const TCHAR *);
 extern a_inode *fsdb_lookup_aino_nname (a_inode *base, const TCHAR *);
 extern int fsdb_exists (const TCHAR *nname);
 extern int same_aname (const TCHAR *an1, const TCHAR *an2);
+extern unsigned int aname_hash (const TCHAR *an);
 
 /* Filesystem-dependent functions.  */
 extern int fsdb_name_invalid (a_inode *, const TCHAR *n);
@@ -150,6 +161,7 @@ extern struct my_opendir_s *my_opendir (const TCHAR*, const TCHAR*);
 extern struct my_opendir_s *my_opendir (const TCHAR*);
 extern void my_closedir (struct my_opendir_s*);
 extern int my_readdir (struct my_opendir_s*, TCHAR*);
+extern bool my_readdir_stat (struct my_opendir_s*, struct mystat*);
 
 extern int my_rmdir (const TCHAR*);
 extern int my_mkdir (const TCHAR*);
@@ -167,6 +179,8 @@ extern uae_s64 my_fsize (struct my_openfile_s*);
 extern unsigned int my_read (struct my_openfile_s*, void*, unsigned int);
 extern unsigned int my_write (struct my_openfile_s*, void*, unsigned int);
 extern int my_truncate (const TCHAR *name, uae_u64 len);
+extern uae_u8 *my_mapfile (const TCHAR *name, uae_s64 *size, void **handle);
+extern void my_unmapfile (uae_u8 *data, void *handle);
 extern int dos_errno (void);
 extern int my_existsfile (const TCHAR *name);
 extern int my_existsdir (const TCHAR *name);
@@ -870,6 +870,8 @@ struct uae_prefs {
 	struct floppyslot floppyslots[4];
 	bool floppy_read_only;
 	bool harddrive_read_only;
+	int harddrive_cache_size;
+	int archive_cache_size;
 	TCHAR dfxlist[MAX_SPARE_DRIVES][MAX_DPATH];
 	int dfxclickvolume_disk[4];
 	int dfxclickvolume_empty[4];
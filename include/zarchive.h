@@ -33,6 +33,8 @@ struct zfile {
     ZFILESEEK zfileseek;
     void *userdata;
     int useparent;
+    void *maphandle; // set if data is a read-only view of the real file
+    struct zstream *stream; // set if data is still being decompressed (datasize < size)
 };
 
 #define ZNODE_FILE 0
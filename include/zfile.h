@@ -52,6 +52,7 @@ extern uae_u8 *zfile_load_data(const TCHAR *name, const uae_u8 *data,int datalen
 extern uae_u8 *zfile_load_file(const TCHAR *name, int *outlen);
 extern struct zfile *zfile_fopen_parent(struct zfile*, const TCHAR*, uae_u64 offset, uae_u64 size);
 extern uae_u8 *zfile_get_data_pointer(struct zfile *z, size_t *len);
+extern const uae_u8 *zfile_get_data_range(struct zfile *z, uae_s64 offset, uae_s64 len);
 extern const TCHAR *zfile_get_ext(const TCHAR *);
 
 extern int zfile_exists (const TCHAR *name);
@@ -102,6 +103,7 @@ extern int zfile_truncate(struct zfile *z, uae_s64 size);
 #define ZFD_DISKHISTORY 0x100 //allow diskhistory (if disk image)
 #define ZFD_CHECKONLY 0x200 //file exists checkc
 #define ZFD_DELAYEDOPEN 0x400 //do not unpack, just get metadata
+#define ZFD_MMAP 0x800 //memory map plain read-only files
 #define ZFD_NORECURSE 0x10000 // do not recurse archives
 #define ZFD_NORMAL (ZFD_ARCHIVE|ZFD_UNPACK)
 #define ZFD_ALL 0x0000ffff
@@ -49,6 +49,7 @@ struct buffer_head
 struct inode
 {
 	struct inode *next;
+	struct inode *hash_next;
 	uae_u32 i_mode;
 	isofs_uid_t i_uid;
 	isofs_gid_t i_gid;
@@ -85,6 +86,20 @@ struct super_block
 	bool unknown_media;
 	struct inode *hash[HASH_SIZE];
 	int hash_miss, hash_hit;
+	/* directory name index, filled one directory at a time */
+	struct isofs_dirent **dirhash;
+	int dirhash_size, dirhash_cnt;
+};
+
+/* One directory record by translated name (Rock Ridge, Joliet or
+ * mapped ISO name). name == NULL marks parent as completely indexed. */
+struct isofs_dirent
+{
+	struct isofs_dirent *next;
+	uae_u32 parent;
+	uae_u32 hash;
+	uae_u32 block, offset;
+	TCHAR *name;
 };
 
 static int gethashindex(struct inode *inode)
@@ -96,7 +111,14 @@ static void free_inode(struct inode *inode)
 {
 	if (!inode)
 		return;
-	inode->i_sb->hash[gethashindex(inode)] = NULL;
+	struct inode **pp = &inode->i_sb->hash[gethashindex(inode)];
+	while (*pp) {
+		if (*pp == inode) {
+			*pp = inode->hash_next;
+			break;
+		}
+		pp = &(*pp)->hash_next;
+	}
 	inode->i_sb->inode_cnt--;
 	xfree(inode->name);
 	xfree(inode->i_comment);
@@ -157,6 +179,7 @@ static void iput(struct inode *inode)
 	sb->inodes = inode;
 	inode->linked = true;
 	sb->inode_cnt++;
+	inode->hash_next = sb->hash[gethashindex(inode)];
 	sb->hash[gethashindex(inode)] = inode;
 }
 
@@ -171,13 +194,13 @@ static struct inode *find_inode(struct super_block *sb, uae_u64 uniq)
 	}
 	sb->hash_miss++;
 
-	inode = sb->inodes;
+	// every linked inode is in its hash chain
 	while (inode) {
 		if (inode->i_ino == uniq) {
 			inode->usecnt++;
 			return inode;
 		}
-		inode = inode->next;
+		inode = inode->hash_next;
 	}
 	return NULL;
 }
@@ -2079,38 +2102,112 @@ static int isofs_name_translate(struct iso_directory_record *de, char *newn, str
 	return i;
 }
 
-static int isofs_cmp(const char *name, char *compare, int dlen)
+/* ASCII case folded, other characters skipped so that everything
+ * _tcsicmp() considers equal lands in the same bucket */
+static uae_u32 isofs_namehash(const TCHAR *name)
 {
-	if (!compare)
-		return 1;
-	/* we don't care about special "." and ".." files */
-	if (dlen == 1) {
-		/* "." */
-		if (compare[0] == 0) {
-			return 1;
-		} else if (compare[0] == 1) {
-			return 1;
+	uae_u32 h = 5381;
+	while (*name) {
+		TCHAR c = *name++;
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+		else if (c >= 0x80)
+			continue;
+		h = h * 33 + c;
+	}
+	return h;
+}
+
+static int isofs_dirhash_index(struct super_block *sb, uae_u32 parent, uae_u32 hash)
+{
+	return ((parent * 0x9e3779b1) ^ hash) & (sb->dirhash_size - 1);
+}
+
+static void isofs_dirhash_add(struct super_block *sb, uae_u32 parent, const TCHAR *name, uae_u32 block, uae_u32 offset)
+{
+	if (sb->dirhash_cnt >= sb->dirhash_size) {
+		int newsize = sb->dirhash_size ? sb->dirhash_size * 2 : 1024;
+		struct isofs_dirent **newhash = xcalloc(struct isofs_dirent*, newsize);
+		if (!newhash)
+			return;
+		int oldsize = sb->dirhash_size;
+		struct isofs_dirent **oldhash = sb->dirhash;
+		sb->dirhash = newhash;
+		sb->dirhash_size = newsize;
+		for (int i = 0; i < oldsize; i++) {
+			struct isofs_dirent *de = oldhash[i];
+			while (de) {
+				struct isofs_dirent *next = de->next;
+				int idx = isofs_dirhash_index(sb, de->parent, de->hash);
+				de->next = newhash[idx];
+				newhash[idx] = de;
+				de = next;
+			}
+		}
+		xfree(oldhash);
+	}
+	struct isofs_dirent *de = xcalloc(struct isofs_dirent, 1);
+	de->parent = parent;
+	de->hash = name ? isofs_namehash(name) : 0;
+	de->name = name ? my_strdup(name) : NULL;
+	de->block = block;
+	de->offset = offset;
+	int idx = isofs_dirhash_index(sb, parent, de->hash);
+	de->next = sb->dirhash[idx];
+	sb->dirhash[idx] = de;
+	sb->dirhash_cnt++;
+}
+
+static struct isofs_dirent *isofs_dirhash_find(struct super_block *sb, uae_u32 parent, const TCHAR *name)
+{
+	if (!sb->dirhash)
+		return NULL;
+	uae_u32 hash = name ? isofs_namehash(name) : 0;
+	struct isofs_dirent *de = sb->dirhash[isofs_dirhash_index(sb, parent, hash)];
+	while (de) {
+		if (de->parent == parent && de->hash == hash) {
+			if (!name && !de->name)
+				return de;
+			if (name && de->name && !_tcsicmp(de->name, name))
+				return de;
 		}
+		de = de->next;
 	}
-	char tmp = compare[dlen];
-	compare[dlen] = 0;
-	int c = stricmp(name, compare);
-	compare[dlen] = tmp;
-	return c;
+	return NULL;
 }
 
-static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, TCHAR *tmpname2, struct iso_directory_record *tmpde, const char *name, const TCHAR *nameu)
+static void isofs_dirhash_free(struct super_block *sb)
+{
+	for (int i = 0; i < sb->dirhash_size; i++) {
+		struct isofs_dirent *de = sb->dirhash[i];
+		while (de) {
+			struct isofs_dirent *next = de->next;
+			xfree(de->name);
+			xfree(de);
+			de = next;
+		}
+	}
+	xfree(sb->dirhash);
+	sb->dirhash = NULL;
+	sb->dirhash_size = 0;
+	sb->dirhash_cnt = 0;
+}
+
+/* Scan all records of dir once and add their names to the index. The
+ * first record wins if a name appears twice, like the old linear scan. */
+static bool isofs_index_dir(struct inode *dir, char *tmpname, struct iso_directory_record *tmpde)
 {
 	unsigned long bufsize = ISOFS_BUFFER_SIZE(dir);
 	unsigned char bufbits = ISOFS_BUFFER_BITS(dir);
 	unsigned long block, f_pos, offset, block_saved, offset_saved;
 	struct buffer_head *bh = NULL;
-	struct isofs_sb_info *sbi = ISOFS_SB(dir->i_sb);
+	struct super_block *sb = dir->i_sb;
+	struct isofs_sb_info *sbi = ISOFS_SB(sb);
+	TCHAR name[MAX_DPATH];
 	int i;
-	TCHAR *jname;
 
 	if (!ISOFS_I(dir)->i_first_extent)
-		return 0;
+		return false;
 
 	f_pos = 0;
 	offset = 0;
@@ -2118,13 +2215,14 @@ static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, TCHAR *t
 
 	while (f_pos < dir->i_size) {
 		struct iso_directory_record *de;
-		int de_len, match, dlen;
+		int de_len, dlen;
 		char *dpnt;
+		TCHAR *jname;
 
 		if (!bh) {
 			bh = isofs_bread(dir, block);
 			if (!bh)
-				return 0;
+				return false;
 		}
 
 		de = (struct iso_directory_record *) (bh->b_data + offset);
@@ -2155,7 +2253,7 @@ static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, TCHAR *t
 			if (offset) {
 				bh = isofs_bread(dir, block);
 				if (!bh)
-					return 0;
+					return false;
 				memcpy((uae_u8*)tmpde + slop, bh->b_data, offset);
 			}
 			de = tmpde;
@@ -2166,9 +2264,13 @@ static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, TCHAR *t
 		/* Basic sanity check, whether name doesn't exceed dir entry */
 		if (de_len < dlen + sizeof(struct iso_directory_record)) {
 			write_log (_T("iso9660: Corrupted directory entry in block %lu of inode %u\n"), block, dir->i_ino);
-			return 0;
+			return false;
 		}
 
+		/* we don't care about special "." and ".." files */
+		if (dlen == 1 && (dpnt[0] == 0 || dpnt[0] == 1))
+			continue;
+
 		jname = NULL;
 		if (sbi->s_rock && ((i = get_rock_ridge_filename(de, tmpname, dir)))) {
 			dlen = i;	/* possibly -1 */
@@ -2184,25 +2286,41 @@ static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, TCHAR *t
 		 * Skip hidden or associated files unless hide or showassoc,
 		 * respectively, is set
 		 */
-		match = 0;
 		if (dlen > 0 && (!sbi->s_hide || (!(de->flags[0-sbi->s_high_sierra] & 1))) && (sbi->s_showassoc || (!(de->flags[0-sbi->s_high_sierra] & 4)))) {
-			if (jname)
-				match = _tcsicmp(jname, nameu) == 0;
-			else
-				match = isofs_cmp(name, dpnt, dlen) == 0;
+			if (jname) {
+				uae_tcslcpy(name, jname, MAX_DPATH);
+			} else {
+				char t = dpnt[dlen];
+				dpnt[dlen] = 0;
+				au_fs_copy(name, MAX_DPATH, dpnt);
+				dpnt[dlen] = t;
+			}
+			if (!isofs_dirhash_find(sb, dir->i_ino, name)) {
+				isofs_normalize_block_and_offset(de, &block_saved, &offset_saved);
+				isofs_dirhash_add(sb, dir->i_ino, name, block_saved, offset_saved);
+			}
 		}
 		xfree (jname);
-		if (match) {
-			isofs_normalize_block_and_offset(de, &block_saved, &offset_saved);
-			struct inode *dinode = isofs_iget(dir->i_sb, block_saved, offset_saved, nameu);
-			iput(dinode);
-			brelse(bh);
-			return dinode;
-		}
-
 	}
 	brelse(bh);
-	return 0;
+	isofs_dirhash_add(sb, dir->i_ino, NULL, 0, 0);
+	return true;
+}
+
+static struct inode *isofs_find_entry(struct inode *dir, char *tmpname, struct iso_directory_record *tmpde, const TCHAR *nameu)
+{
+	struct super_block *sb = dir->i_sb;
+
+	if (!isofs_dirhash_find(sb, dir->i_ino, NULL)) {
+		if (!isofs_index_dir(dir, tmpname, tmpde))
+			return 0;
+	}
+	struct isofs_dirent *de = isofs_dirhash_find(sb, dir->i_ino, nameu);
+	if (!de)
+		return 0;
+	struct inode *dinode = isofs_iget(sb, de->block, de->offset, nameu);
+	iput(dinode);
+	return dinode;
 }
 
 /* Acorn extensions written by Matthew Wilcox <willy@bofh.ai> 1998 */
@@ -2430,7 +2548,8 @@ void isofs_unmount(void *sbp)
 
 	if (!sb)
 		return;
-	write_log (_T("miss: %d hit: %d\n"), sb->hash_miss, sb->hash_hit);
+	write_log (_T("miss: %d hit: %d names: %d\n"), sb->hash_miss, sb->hash_hit, sb->dirhash_cnt);
+	isofs_dirhash_free(sb);
 	inode = sb->inodes;
 	while (inode) {
 		struct inode *next = inode->next;
@@ -2551,16 +2670,13 @@ bool isofs_stat(void *sbp, uae_u64 uniq, struct mystat *statbuf)
 bool isofs_exists(void *sbp, uae_u64 parent, const TCHAR *name, uae_u64 *uniq)
 {
 	char tmp1[1024];
-	TCHAR tmp1x[1024];
 	char tmp2[1024];
-	char tmp3[1024];
 	struct super_block *sb = (struct super_block*)sbp;
 	struct inode *inode = find_inode(sb, parent);
 
 	if (!inode)
 		return false;
-	ua_fs_copy(tmp3, sizeof tmp3, name, '_');
-	inode = isofs_find_entry(inode, tmp1, tmp1x, (struct iso_directory_record*)tmp2, tmp3, name);
+	inode = isofs_find_entry(inode, tmp1, (struct iso_directory_record*)tmp2, name);
 	if (inode) {
 		*uniq = inode->i_ino;
 		return true;
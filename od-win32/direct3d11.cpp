@@ -285,6 +285,9 @@ struct d3d11struct
 	int framecount;
 	UINT syncinterval;
 	bool turbo_skip;
+	// RTG damage: rows touched since last staging copy, -1 = nothing recorded
+	int dirty_miny, dirty_maxy;
+	bool dirty_fulllock, dirty_stale;
 	float vblank;
 	DWM_FRAME_COUNT lastframe;
 	int frames_since_init;
@@ -2050,6 +2053,8 @@ static bool CreateTexture(struct d3d11struct *d3d)
 		write_log(_T("CreateTexture2D (staging) failed: %08x\n"), hr);
 		return false;
 	}
+	d3d->dirty_miny = d3d->dirty_maxy = -1;
+	d3d->dirty_stale = true;
 
 	desc.Width = d3d->m_bitmapWidth;
 	desc.Height = d3d->m_bitmapHeight;
@@ -5126,6 +5131,7 @@ static uae_u8 *xD3D11_locktexture(int monid, int *pitch, int *width, int *height
 	}
 	*pitch = map.RowPitch;
 	d3d->texturelocked++;
+	d3d->dirty_fulllock = fullupdate != 0;
 	return (uae_u8*)map.pData;
 }
 
@@ -5146,12 +5152,25 @@ static void xD3D11_unlocktexture(int monid, int y_start, int y_end)
 	}
 
 	if (d3d->turbo_skip) {
+		d3d->dirty_stale = true;
 		return;
 	}
 
+	if (y_start < 0 || y_end < 0) {
+		// RTG unlock: upload only the damaged rows if nothing else could have touched the staging texture
+		if (d3d->dirty_miny >= 0 && !d3d->dirty_fulllock && !d3d->dirty_stale) {
+			y_start = d3d->dirty_miny;
+			y_end = d3d->dirty_maxy + 1;
+			if (y_end > d3d->m_bitmapHeight)
+				y_end = d3d->m_bitmapHeight;
+		}
+		d3d->dirty_miny = d3d->dirty_maxy = -1;
+	}
+
 	if (y_start < 0 || y_end < 0) {
 		d3d->m_deviceContext->CopyResource(d3d->texture2d, d3d->texture2dstaging);
-	} else {
+		d3d->dirty_stale = false;
+	} else if (y_start < y_end) {
 		D3D11_BOX box = { 0 };
 		box.right = d3d->m_bitmapWidth;
 		box.top = y_start;
@@ -5164,6 +5183,14 @@ static void xD3D11_unlocktexture(int monid, int y_start, int y_end)
 static void xD3D11_flushtexture(int monid, int miny, int maxy)
 {
 	struct d3d11struct *d3d = &d3d11data[monid];
+
+	if (miny < 0 || maxy < 0) {
+		return;
+	}
+	if (d3d->dirty_miny < 0 || miny < d3d->dirty_miny)
+		d3d->dirty_miny = miny;
+	if (maxy > d3d->dirty_maxy)
+		d3d->dirty_maxy = maxy;
 }
 
 static void xD3D11_restore(int monid, bool checkonly)
@@ -194,6 +194,8 @@ struct my_opendir_s {
 	HANDLE h;
 	WIN32_FIND_DATA fd;
 	int first;
+	int fat;
+	TCHAR path[MAX_DPATH];
 };
 
 struct my_opendir_s *my_opendir (const TCHAR *name)
@@ -209,17 +211,20 @@ struct my_opendir_s *my_opendir (const TCHAR *name, const TCHAR *mask)
 	if (currprefs.win32_filesystem_mangle_reserved_names == false)
 		_tcscpy (tmp, PATHPREFIX);
 	_tcscat (tmp, name);
-	_tcscat (tmp, _T("\\"));
-	_tcscat (tmp, mask);
 	mod = xmalloc (struct my_opendir_s, 1);
 	if (!mod)
 		return NULL;
-	mod->h = FindFirstFile(tmp, &mod->fd);
+	_tcscpy (mod->path, tmp);
+	_tcscat (tmp, _T("\\"));
+	_tcscat (tmp, mask);
+	// no 8.3 names and bigger directory reads per kernel call
+	mod->h = FindFirstFileEx(tmp, FindExInfoBasic, &mod->fd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
 	if (mod->h == INVALID_HANDLE_VALUE) {
 		xfree (mod);
 		return NULL;
 	}
 	mod->first = 1;
+	mod->fat = -1;
 	return mod;
 }
 
@@ -293,6 +298,55 @@ unsigned int my_write (struct my_openfile_s *mos, void *b, unsigned int size)
 	return written;
 }
 
+// 32-bit address space is too precious to map huge images
+#define MAX_MAPFILE_SIZE_32 (256 * 1024 * 1024)
+
+uae_u8 *my_mapfile (const TCHAR *name, uae_s64 *sizep, void **handlep)
+{
+	HANDLE h, hm;
+	LARGE_INTEGER li;
+	uae_u8 *data = NULL;
+	const TCHAR *namep;
+	TCHAR path[MAX_DPATH];
+
+	if (currprefs.win32_filesystem_mangle_reserved_names == false) {
+		_tcscpy (path, PATHPREFIX);
+		_tcscat (path, name);
+		namep = path;
+	} else {
+		namep = name;
+	}
+	h = CreateFile (namep, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (!GetFileSizeEx (h, &li) || li.QuadPart == 0 || (sizeof (void*) < 8 && li.QuadPart > MAX_MAPFILE_SIZE_32)) {
+		CloseHandle (h);
+		return NULL;
+	}
+	hm = CreateFileMapping (h, NULL, PAGE_READONLY, 0, 0, NULL);
+	// the mapping keeps the file open
+	CloseHandle (h);
+	if (!hm)
+		return NULL;
+	data = (uae_u8*)MapViewOfFile (hm, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		write_log (_T("failed to map '%s', err=%d\n"), name, GetLastError ());
+		CloseHandle (hm);
+		return NULL;
+	}
+	*sizep = li.QuadPart;
+	*handlep = hm;
+	return data;
+}
+
+void my_unmapfile (uae_u8 *data, void *handle)
+{
+	if (data)
+		UnmapViewOfFile (data);
+	if (handle)
+		CloseHandle ((HANDLE)handle);
+}
+
 BOOL SetFileAttributesSafe (const TCHAR *name, DWORD attr)
 {
 	DWORD last;
@@ -603,10 +657,46 @@ static bool isfat (HANDLE h)
 	return false;
 }
 
-bool my_stat (const TCHAR *name, struct mystat *statbuf)
+static void my_stat_fill (struct mystat *statbuf, DWORD attr, const FILETIME *ctime, const FILETIME *wtime, uae_u64 size, bool fat)
 {
-	DWORD attr, ok;
 	FILETIME ft, lft;
+
+	if (fat) {
+		// fat lastwritetime only has 2 second resolution
+		// fat creationtime has 10ms resolution
+		// use creationtime if creationtime is inside lastwritetime 2s resolution
+		ULARGE_INTEGER ct, wt;
+		ct.HighPart = ctime->dwHighDateTime;
+		ct.LowPart = ctime->dwLowDateTime;
+		wt.HighPart = wtime->dwHighDateTime;
+		wt.LowPart = wtime->dwLowDateTime;
+		uae_u64 ctsec = ct.QuadPart / 10000000;
+		uae_u64 wtsec = wt.QuadPart / 10000000;
+		if (wtsec == ctsec || wtsec + 1 == ctsec) {
+			ft = *ctime;
+		} else {
+			ft = *wtime;
+		}
+	} else {
+		ft = *wtime;
+	}
+	statbuf->size = size;
+
+	statbuf->mode = (attr & FILE_ATTRIBUTE_READONLY) ? FILEFLAG_READ : FILEFLAG_READ | FILEFLAG_WRITE;
+	if (attr & FILE_ATTRIBUTE_ARCHIVE)
+		statbuf->mode |= FILEFLAG_ARCHIVE;
+	if (attr & FILE_ATTRIBUTE_DIRECTORY)
+		statbuf->mode |= FILEFLAG_DIR;
+
+	FileTimeToLocalFileTime (&ft,&lft);
+	uae_u64 t = (*(__int64 *)&lft-((__int64)(369*365+89)*(__int64)(24*60*60)*(__int64)10000000));
+	statbuf->mtime.tv_sec = t / 10000000;
+	statbuf->mtime.tv_usec = (t / 10) % 1000000;
+}
+
+bool my_stat (const TCHAR *name, struct mystat *statbuf)
+{
+	DWORD ok;
 	HANDLE h;
 	BY_HANDLE_FILE_INFORMATION fi;
 	const TCHAR *namep;
@@ -630,46 +720,31 @@ bool my_stat (const TCHAR *name, struct mystat *statbuf)
 	ok = GetFileInformationByHandle (h, &fi);
 	CloseHandle (h);
 
-	attr = 0;
-	ft.dwHighDateTime = ft.dwLowDateTime = 0;
-	if (ok) {
-		attr = fi.dwFileAttributes;
-		if (fat) {
-			// fat lastwritetime only has 2 second resolution
-			// fat creationtime has 10ms resolution
-			// use creationtime if creationtime is inside lastwritetime 2s resolution
-			ULARGE_INTEGER ct, wt;
-			ct.HighPart = fi.ftCreationTime.dwHighDateTime;
-			ct.LowPart = fi.ftCreationTime.dwLowDateTime;
-			wt.HighPart = fi.ftLastWriteTime.dwHighDateTime;
-			wt.LowPart = fi.ftLastWriteTime.dwLowDateTime;
-			uae_u64 ctsec = ct.QuadPart / 10000000;
-			uae_u64 wtsec = wt.QuadPart / 10000000;
-			if (wtsec == ctsec || wtsec + 1 == ctsec) {
-				ft = fi.ftCreationTime;
-			} else {
-				ft = fi.ftLastWriteTime;
-			}
-		} else {
-			ft = fi.ftLastWriteTime;
-		}
-		statbuf->size = ((uae_u64)fi.nFileSizeHigh << 32) | fi.nFileSizeLow;
-	} else {
+	if (!ok) {
 		write_log (_T("GetFileInformationByHandle(%s) failed: %d\n"), namep, GetLastError ());
 		return false;
 	}
+	my_stat_fill (statbuf, fi.dwFileAttributes, &fi.ftCreationTime, &fi.ftLastWriteTime,
+		((uae_u64)fi.nFileSizeHigh << 32) | fi.nFileSizeLow, fat);
+	return true;
+}
 
-	statbuf->mode = (attr & FILE_ATTRIBUTE_READONLY) ? FILEFLAG_READ : FILEFLAG_READ | FILEFLAG_WRITE;
-	if (attr & FILE_ATTRIBUTE_ARCHIVE)
-		statbuf->mode |= FILEFLAG_ARCHIVE;
-	if (attr & FILE_ATTRIBUTE_DIRECTORY)
-		statbuf->mode |= FILEFLAG_DIR;
-
-	FileTimeToLocalFileTime (&ft,&lft);
-	uae_u64 t = (*(__int64 *)&lft-((__int64)(369*365+89)*(__int64)(24*60*60)*(__int64)10000000));
-	statbuf->mtime.tv_sec = t / 10000000;
-	statbuf->mtime.tv_usec = (t / 10) % 1000000;
-
+/* stat of the entry last returned by my_readdir(), without opening it */
+bool my_readdir_stat (struct my_opendir_s *mod, struct mystat *statbuf)
+{
+	// my_stat() follows reparse points, find data describes the link itself
+	if (mod->fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+		return false;
+	if (mod->fat < 0) {
+		HANDLE h = CreateFile (mod->path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		mod->fat = 0;
+		if (h != INVALID_HANDLE_VALUE) {
+			mod->fat = isfat (h) ? 1 : 0;
+			CloseHandle (h);
+		}
+	}
+	my_stat_fill (statbuf, mod->fd.dwFileAttributes, &mod->fd.ftCreationTime, &mod->fd.ftLastWriteTime,
+		((uae_u64)mod->fd.nFileSizeHigh << 32) | mod->fd.nFileSizeLow, mod->fat != 0);
 	return true;
 }
 
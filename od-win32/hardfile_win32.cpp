@@ -2271,7 +2271,7 @@ emptyreal:
 				write_log (_T("HDF '%s' re-opened in zfile-mode\n"), name);
 				CloseHandle (h);
 				hfd->handle->h = INVALID_HANDLE_VALUE;
-				hfd->handle->zf = zfile_fopen (name, _T("rb"), ZFD_NORMAL);
+				hfd->handle->zf = zfile_fopen (name, _T("rb"), ZFD_NORMAL | ZFD_MMAP);
 				hfd->handle->zfile = 1;
 				if (!hfd->handle->zf)
 					goto end;
@@ -2640,6 +2640,15 @@ int hdf_read_target(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
 		return len2;
 	}
 
+	if (hfd->handle_valid == HDF_HANDLE_ZFILE && offset + len <= hfd->physsize) {
+		// in-memory or mapped image, no need to go through the read cache
+		const uae_u8 *data = zfile_get_data_range(hfd->handle->zf, hfd->offset + offset, len);
+		if (data) {
+			memcpy(buffer, data, len);
+			return len;
+		}
+	}
+
 	while (len > 0) {
 		int maxlen;
 		DWORD ret;
@@ -273,7 +273,7 @@ mp3decoder::mp3decoder()
 	}
 }
 
-uae_u8 *mp3decoder::get (struct zfile *zf, uae_u8 *outbuf, int maxsize)
+uae_u8 *mp3decoder::get (struct zfile *zf, uae_u8 *outbuf, int maxsize, mp3decoder_progress progress, void *userdata)
 {
 	MMRESULT mmr;
 	unsigned long rawbufsize = 0;
@@ -320,6 +320,8 @@ uae_u8 *mp3decoder::get (struct zfile *zf, uae_u8 *outbuf, int maxsize)
 			break;
 		memcpy(outbuf + outoffset, rawbuf, mp3streamHead.cbDstLengthUsed);
 		outoffset += mp3streamHead.cbDstLengthUsed;
+		if (progress && !progress(outoffset, userdata))
+			break;
 	}
 	acmStreamUnprepareHeader(h, &mp3streamHead, 0);
 	LocalFree(rawbuf);
@@ -1,4 +1,7 @@
 
+// called after each decoded block, return false to stop decoding
+typedef bool (*mp3decoder_progress)(int decoded, void *userdata);
+
 class mp3decoder
 {
 	void *g_mp3stream;
@@ -6,6 +9,6 @@ public:
 	mp3decoder(struct zfile *zf);
 	mp3decoder();
 	~mp3decoder();
-	uae_u8 *get(struct zfile *zf, uae_u8 *, int maxsize);
+	uae_u8 *get(struct zfile *zf, uae_u8 *, int maxsize, mp3decoder_progress progress = NULL, void *userdata = NULL);
 	uae_u32 getsize(struct zfile *zf);
 };
@@ -5260,6 +5260,7 @@ static void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 					p2 += vidinfo->rowbytes;
 				}
 				vidinfo->rtg_clear_flag--;
+				picasso_invalidate(monid, 0, 0, vidinfo->maxwidth, vidinfo->maxheight);
 			}
 
 			dst += vidinfo->offset;
@@ -5307,27 +5308,38 @@ static void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 						y += vidinfo->splitypos;
 					}
 					if (y < pheight) {
-						int w = (gwwpagesize[index] + state->BytesPerPixel - 1) / state->BytesPerPixel;
+						// only convert the bytes covered by this page, not the rest of the row
+						int pleft = (int)(p + gwwpagesize[index] - (src + off)) - realoffset;
+						int w;
 						x = (realoffset % state->BytesPerRow) / state->BytesPerPixel;
+						// page can start inside a pixel (24-bit), span counts from its first byte
+						pleft += realoffset % state->BytesPerRow - x * state->BytesPerPixel;
 						if (x < pwidth) {
-							copyrow(monid, src + off, dst, x, y, pwidth - x,
+							w = (pleft + state->BytesPerPixel - 1) / state->BytesPerPixel;
+							if (w > pwidth - x) {
+								w = pwidth - x;
+							}
+							copyrow(monid, src + off, dst, x, y, w,
 								state->BytesPerRow, state->BytesPerPixel,
 								x, y, vidinfo->rowbytes, vidinfo->pixbytes,
 								vidinfo->picasso_convert, p96_rgbx16);
 							flushlines++;
 						}
-						w = (gwwpagesize[index] - (state->BytesPerRow - x * state->BytesPerPixel) + state->BytesPerPixel - 1) / state->BytesPerPixel;
+						pleft -= state->BytesPerRow - x * state->BytesPerPixel;
 						if (y < miny) {
 							miny = y;
 						}
 						y++;
-						while (y < pheight && w > 0) {
-							int maxw = w > pwidth ? pwidth : w;
+						while (y < pheight && pleft > 0) {
+							int maxw = (pleft + state->BytesPerPixel - 1) / state->BytesPerPixel;
+							if (maxw > pwidth) {
+								maxw = pwidth;
+							}
 							copyrow(monid, src + off, dst, 0, y, maxw,
 								state->BytesPerRow, state->BytesPerPixel,
 								0, y, vidinfo->rowbytes, vidinfo->pixbytes,
 								vidinfo->picasso_convert, p96_rgbx16);
-							w -= maxw;
+							pleft -= state->BytesPerRow;
 							y++;
 							flushlines++;
 						}
@@ -5349,6 +5361,8 @@ static void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 		}
 		if (dstp) {
 			picasso_flushoverlay(index, src, off, dstp);
+			// overlay can land anywhere, don't limit texture upload to damaged rows
+			picasso_invalidate(monid, -1, -1, -1, -1);
 		}
 	}
 
@@ -323,6 +323,27 @@ int same_aname (const TCHAR *an1, const TCHAR *an2)
 	return CompareString (LOCALE_INVARIANT, NORM_IGNORECASE, an1, -1, an2, -1) == CSTR_EQUAL;
 }
 
+/* Names that same_aname() considers equal have equal sort keys,
+ * so hash the sort key instead of the name itself. */
+unsigned int aname_hash (const TCHAR *an)
+{
+	BYTE buf[1024], *key = buf;
+	unsigned int h = 0;
+	int len = LCMapString (LOCALE_INVARIANT, LCMAP_SORTKEY | NORM_IGNORECASE, an, -1, (LPWSTR)buf, sizeof buf);
+	if (len <= 0) {
+		len = LCMapString (LOCALE_INVARIANT, LCMAP_SORTKEY | NORM_IGNORECASE, an, -1, NULL, 0);
+		key = len > 0 ? xmalloc (BYTE, len) : NULL;
+		if (!key)
+			return 0;
+		len = LCMapString (LOCALE_INVARIANT, LCMAP_SORTKEY | NORM_IGNORECASE, an, -1, (LPWSTR)key, len);
+	}
+	for (int i = 0; i < len; i++)
+		h = h * 31 + key[i];
+	if (key != buf)
+		xfree (key);
+	return h;
+}
+
 void to_lower(TCHAR *s, int len)
 {
 	if (len < 0) {
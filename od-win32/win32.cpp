@@ -104,6 +104,7 @@
 #endif
 #include "uae/ppc.h"
 #include "fsdb.h"
+#include "filesys.h"
 #include "uae/time.h"
 #include "specialmonitors.h"
 #include "debug.h"
@@ -6697,6 +6698,12 @@ static int parseargs(const TCHAR *argx, const TCHAR *np, const TCHAR *np2)
 		zfile_convertimage(np, np2);
 		return -1;
 	}
+#ifdef FILESYS
+	if (!_tcscmp(arg, _T("vhddiff")) && np && np2) {
+		vhd_create_differencing(np2, np);
+		return -1;
+	}
+#endif
 	if (!_tcscmp(arg, _T("console"))) {
 		console_started = 1;
 		return 1;
@@ -1612,11 +1612,10 @@ void gfx_unlock_picasso(int monid, bool dorender)
 		gfx_lock();
 	}
 	mon->rtg_locked = false;
-	if (dorender) {
-		if (mon->p96_double_buffer_needs_flushing) {
-			D3D_flushtexture(monid, mon->p96_double_buffer_first, mon->p96_double_buffer_last);
-			mon->p96_double_buffer_needs_flushing = 0;
-		}
+	// pass damaged rows even without render, texture upload happens at unlock time
+	if (mon->p96_double_buffer_needs_flushing) {
+		D3D_flushtexture(monid, mon->p96_double_buffer_first, mon->p96_double_buffer_last);
+		mon->p96_double_buffer_needs_flushing = 0;
 	}
 	D3D_unlocktexture(monid, -1, -1);
 	if (dorender) {
@@ -2594,6 +2593,17 @@ void DX_Invalidate(struct AmigaMonitor *mon, int x, int y, int width, int height
 	}
 	last = y + height - 1;
 	lastx = x + width - 1;
+	if (mon->p96_double_buffer_needs_flushing) {
+		// accumulate until next flush
+		if (mon->p96_double_buffer_first < y)
+			y = mon->p96_double_buffer_first;
+		if (mon->p96_double_buffer_last > last)
+			last = mon->p96_double_buffer_last;
+		if (mon->p96_double_buffer_firstx < x)
+			x = mon->p96_double_buffer_firstx;
+		if (mon->p96_double_buffer_lastx > lastx)
+			lastx = mon->p96_double_buffer_lastx;
+	}
 	mon->p96_double_buffer_first = y;
 	mon->p96_double_buffer_last  = last;
 	mon->p96_double_buffer_firstx = x;
@@ -13,6 +13,9 @@ static struct
         uint8_t status;
         int is_opl3;
         int opl_emu;
+#ifdef UAE
+        int newm;
+#endif
         
         void (*timer_callback)(void *param, int timer, int64_t period);
         void *timer_param;
@@ -53,6 +56,9 @@ void opl_init(void (*timer_callback)(void *param, int timer, int64_t period), vo
                 opl[nr].is_opl3 = is_opl3;	
                 opl[nr].opl_emu = opl_emu;
 	}
+#ifdef UAE
+        opl[nr].newm = 0;
+#endif
 }
 
 void opl_status_update(int nr)
@@ -79,6 +85,73 @@ void opl_timer_over(int nr, int timer)
         opl_status_update(nr);
 }
 
+static void opl_write_timer(int nr, uint8_t val)
+{
+        switch (opl[nr].addr)
+        {
+                case 0x02: /*Timer 1*/
+                opl[nr].timer[0] = 256 - val;
+                break;
+                case 0x03: /*Timer 2*/
+                opl[nr].timer[1] = 256 - val;
+                break;
+                case 0x04: /*Timer control*/
+                if (val & CTRL_IRQ_RESET) /*IRQ reset*/
+                {
+                        opl[nr].status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
+                        opl_status_update(nr);
+                        return;
+                }
+                if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER1_CTRL)
+                {
+                        if (val & CTRL_TIMER1_CTRL)
+                                opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
+                        else
+                                opl[nr].timer_callback(opl[nr].timer_param, 0, 0);
+                }
+                if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER2_CTRL)
+                {
+                        if (val & CTRL_TIMER2_CTRL)
+                                opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
+                        else
+                                opl[nr].timer_callback(opl[nr].timer_param, 1, 0);
+                }
+                opl[nr].status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
+                opl[nr].timer_ctrl = val;
+                break;
+        }
+}
+
+#ifdef UAE
+/*Synth register write only. Called from the OPL thread.*/
+void opl_write_reg(int nr, uint16_t reg, uint8_t val)
+{
+	if (!opl[nr].is_opl3 || !opl[nr].opl_emu)
+		opl[nr].chip.WriteReg(reg, val);
+	else
+		OPL3_WriteReg(&opl[nr].opl3chip, reg, val);
+}
+
+/*Address latch, timers and status. Called from the emulation thread, never
+  touches the synth state. Returns register number if the write needs to be
+  forwarded to opl_write_reg(), -1 for address writes.*/
+int opl_write_port(int nr, uint16_t addr, uint8_t val)
+{
+        if (!(addr & 1))
+        {
+                /*Same as DBOPL/Nuked WriteAddr(), using shadowed OPL3 mode bit*/
+                opl[nr].addr = val;
+                if (opl[nr].is_opl3 && (addr & 2) && (opl[nr].newm || val == 0x05))
+                        opl[nr].addr |= 0x100;
+                return -1;
+        }
+        if (opl[nr].is_opl3 && opl[nr].addr == 0x105)
+                opl[nr].newm = val & 0x01;
+        opl_write_timer(nr, val);
+        return opl[nr].addr;
+}
+#endif
+
 void opl_write(int nr, uint16_t addr, uint8_t val)
 {
         if (!(addr & 1))
@@ -95,39 +168,7 @@ void opl_write(int nr, uint16_t addr, uint8_t val)
 		else
 			OPL3_WriteReg(&opl[nr].opl3chip, opl[nr].addr, val);
 
-                switch (opl[nr].addr)
-                {
-                        case 0x02: /*Timer 1*/
-                        opl[nr].timer[0] = 256 - val;
-                        break;
-                        case 0x03: /*Timer 2*/
-                        opl[nr].timer[1] = 256 - val;
-                        break;
-                        case 0x04: /*Timer control*/
-                        if (val & CTRL_IRQ_RESET) /*IRQ reset*/
-                        {
-                                opl[nr].status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
-                                opl_status_update(nr);
-                                return;
-                        }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER1_CTRL)
-                        {
-                                if (val & CTRL_TIMER1_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
-                                else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, 0);
-                        }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER2_CTRL)
-                        {
-                                if (val & CTRL_TIMER2_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
-                                else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, 0);
-                        }
-                        opl[nr].status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
-                        opl[nr].timer_ctrl = val;
-                        break;
-                }
+                opl_write_timer(nr, val);
         }
                 
 }
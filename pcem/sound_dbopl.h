@@ -7,6 +7,10 @@ extern "C" {
         void opl_timer_over(int nr, int timer);
         void opl2_update(int nr, int16_t *buffer, int samples);
         void opl3_update(int nr, int16_t *buffer, int samples);
+#ifdef UAE
+        int opl_write_port(int nr, uint16_t addr, uint8_t val);
+        void opl_write_reg(int nr, uint16_t reg, uint8_t val);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,219 @@
 
 /*Interfaces between PCem and the actual OPL emulator*/
 
+#ifdef UAE
+/*Synth runs in its own thread. Emulation thread only handles address latch,
+  timers and status and queues register writes with their sample position.
+  OPL thread renders up to each queued position before applying the write so
+  output is identical to the synchronous version.*/
+
+enum
+{
+        OPL_FIFO_WRITE_0,
+        OPL_FIFO_WRITE_1,
+        OPL_FIFO_SYNC
+};
+
+#define OPL_FIFO_ENTRIES (opl->fifo_write_idx - opl->fifo_read_idx)
+#define OPL_FIFO_FULL    ((opl->fifo_write_idx - opl->fifo_read_idx) >= OPL_FIFO_SIZE)
+#define OPL_FIFO_EMPTY   (opl->fifo_read_idx == opl->fifo_write_idx)
+
+static void opl_render(opl_t *opl, int pos)
+{
+        if (opl->pos < pos)
+        {
+                if (opl->is_opl3)
+                {
+                        opl3_update(0, &opl->buffer[opl->pos*2], pos - opl->pos);
+                }
+                else
+                {
+                        opl2_update(0, &opl->buffer[opl->pos*2], pos - opl->pos);
+                        opl2_update(1, &opl->buffer[opl->pos*2 + 1], pos - opl->pos);
+                }
+                for (; opl->pos < pos; opl->pos++)
+                {
+                        opl->filtbuf[0] = opl->buffer[opl->pos*2]   = (opl->buffer[opl->pos*2]   / 2);
+                        opl->filtbuf[1] = opl->buffer[opl->pos*2+1] = (opl->buffer[opl->pos*2+1] / 2);
+                }
+        }
+}
+
+static void opl_fifo_thread(void *param)
+{
+        opl_t *opl = (opl_t *)param;
+
+        while (opl->fifo_thread_state > 0)
+        {
+                thread_set_event(opl->fifo_not_full_event);
+                thread_wait_event(opl->wake_fifo_thread, -1);
+                thread_reset_event(opl->wake_fifo_thread);
+                while (!OPL_FIFO_EMPTY)
+                {
+                        opl_fifo_entry_t *fifo = &opl->fifo[opl->fifo_read_idx & OPL_FIFO_MASK];
+                        int type = fifo->type;
+
+                        opl_render(opl, fifo->pos);
+                        if (type == OPL_FIFO_WRITE_0)
+                                opl_write_reg(0, fifo->reg, fifo->val);
+                        else if (type == OPL_FIFO_WRITE_1)
+                                opl_write_reg(1, fifo->reg, fifo->val);
+
+                        opl->fifo_read_idx++;
+
+                        if (type == OPL_FIFO_SYNC)
+                                thread_set_event(opl->fifo_sync_event);
+                        if (OPL_FIFO_ENTRIES > OPL_FIFO_SIZE - OPL_FIFO_SIZE / 8)
+                                thread_set_event(opl->fifo_not_full_event);
+                }
+        }
+        opl->fifo_thread_state = 0;
+}
+
+static void opl_queue(opl_t *opl, int type, uint16_t reg, uint8_t val)
+{
+        opl_fifo_entry_t *fifo = &opl->fifo[opl->fifo_write_idx & OPL_FIFO_MASK];
+
+        if (OPL_FIFO_FULL)
+        {
+                thread_reset_event(opl->fifo_not_full_event);
+                if (OPL_FIFO_FULL)
+                {
+                        thread_wait_event(opl->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
+                }
+        }
+
+        fifo->pos = sound_pos_global;
+        fifo->reg = reg;
+        fifo->val = val;
+        fifo->type = type;
+
+        opl->fifo_write_idx++;
+
+        if (OPL_FIFO_ENTRIES > OPL_FIFO_SIZE - OPL_FIFO_SIZE / 8 || OPL_FIFO_ENTRIES < 8)
+                thread_set_event(opl->wake_fifo_thread);
+}
+
+static void opl_write_nr(opl_t *opl, int nr, uint16_t a, uint8_t v)
+{
+        int reg = opl_write_port(nr, a, v);
+        if (reg < 0)
+                return;
+        if (!opl->fifo_thread)
+        {
+                opl_render(opl, sound_pos_global);
+                opl_write_reg(nr, reg, v);
+                return;
+        }
+        opl_queue(opl, nr ? OPL_FIFO_WRITE_1 : OPL_FIFO_WRITE_0, reg, v);
+}
+
+/*Block end: wait until OPL thread has rendered the whole buffer*/
+static void opl_sync(opl_t *opl)
+{
+        if (!opl->fifo_thread)
+        {
+                opl_render(opl, sound_pos_global);
+                return;
+        }
+        thread_reset_event(opl->fifo_sync_event);
+        opl_queue(opl, OPL_FIFO_SYNC, 0, 0);
+        thread_set_event(opl->wake_fifo_thread);
+        thread_wait_event(opl->fifo_sync_event, -1);
+}
+
+static void opl_start(opl_t *opl, int is_opl3)
+{
+        opl->is_opl3 = is_opl3;
+        opl->fifo_read_idx = opl->fifo_write_idx = 0;
+        opl->wake_fifo_thread = thread_create_event();
+        opl->fifo_not_full_event = thread_create_event();
+        opl->fifo_sync_event = thread_create_event();
+        opl->fifo_thread_state = 1;
+        opl->fifo_thread = thread_create(opl_fifo_thread, opl);
+}
+
+void opl_close(opl_t *opl)
+{
+        if (opl->fifo_thread_state) {
+            opl->fifo_thread_state = -1;
+            thread_set_event(opl->wake_fifo_thread);
+            while (opl->fifo_thread_state == -1) {
+                thread_sleep(1);
+            }
+            thread_kill(opl->fifo_thread);
+        }
+        opl->fifo_thread = NULL;
+        if (opl->wake_fifo_thread)
+            thread_destroy_event(opl->wake_fifo_thread);
+        if (opl->fifo_not_full_event)
+            thread_destroy_event(opl->fifo_not_full_event);
+        if (opl->fifo_sync_event)
+            thread_destroy_event(opl->fifo_sync_event);
+        opl->wake_fifo_thread = opl->fifo_not_full_event = opl->fifo_sync_event = NULL;
+}
+
+/*Status register only depends on timers, no need to sync the synth on reads*/
+uint8_t opl2_read(uint16_t a, void *priv)
+{
+        cycles -= (int)(isa_timing * 8);
+        return opl_read(0, a);
+}
+void opl2_write(uint16_t a, uint8_t v, void *priv)
+{
+        opl_t *opl = (opl_t *)priv;
+
+        opl_write_nr(opl, 0, a, v);
+        opl_write_nr(opl, 1, a, v);
+}
+
+uint8_t opl2_l_read(uint16_t a, void *priv)
+{
+        cycles -= (int)(isa_timing * 8);
+        return opl_read(0, a);
+}
+void opl2_l_write(uint16_t a, uint8_t v, void *priv)
+{
+        opl_t *opl = (opl_t *)priv;
+
+        opl_write_nr(opl, 0, a, v);
+}
+
+uint8_t opl2_r_read(uint16_t a, void *priv)
+{
+        cycles -= (int)(isa_timing * 8);
+        return opl_read(1, a);
+}
+void opl2_r_write(uint16_t a, uint8_t v, void *priv)
+{
+        opl_t *opl = (opl_t *)priv;
+
+        opl_write_nr(opl, 1, a, v);
+}
+
+uint8_t opl3_read(uint16_t a, void *priv)
+{
+        cycles -= (int)(isa_timing * 8);
+        return opl_read(0, a);
+}
+void opl3_write(uint16_t a, uint8_t v, void *priv)
+{
+        opl_t *opl = (opl_t *)priv;
+
+        opl_write_nr(opl, 0, a, v);
+}
+
+void opl2_update2(opl_t *opl)
+{
+        opl_sync(opl);
+}
+
+void opl3_update2(opl_t *opl)
+{
+        opl_sync(opl);
+}
+
+#else
 
 uint8_t opl2_read(uint16_t a, void *priv)
 {
@@ -104,6 +317,8 @@ void opl3_update2(opl_t *opl)
         }
 }
 
+#endif
+
 void ym3812_timer_set_0(void *param, int timer, int64_t period)
 {
         opl_t *opl = (opl_t *)param;
@@ -158,6 +373,9 @@ void opl2_init(opl_t *opl)
         timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
         timer_add(&opl->timers[1][0], opl_timer_callback10, (void *)opl, 0);
         timer_add(&opl->timers[1][1], opl_timer_callback11, (void *)opl, 0);
+#ifdef UAE
+        opl_start(opl, 0);
+#endif
 }
 
 void opl3_init(opl_t *opl, int opl_emu)
@@ -165,5 +383,8 @@ void opl3_init(opl_t *opl, int opl_emu)
         opl_init(ymf262_timer_set, opl, 0, 1, opl_emu);
         timer_add(&opl->timers[0][0], opl_timer_callback00, (void *)opl, 0);
         timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
+#ifdef UAE
+        opl_start(opl, 1);
+#endif
 }
 
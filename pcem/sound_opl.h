@@ -1,4 +1,18 @@
 #include "sound.h"
+#ifdef UAE
+#include "thread.h"
+
+#define OPL_FIFO_SIZE 4096
+#define OPL_FIFO_MASK (OPL_FIFO_SIZE - 1)
+
+typedef struct opl_fifo_entry_t
+{
+        int pos;
+        uint16_t reg;
+        uint8_t val;
+        uint8_t type;
+} opl_fifo_entry_t;
+#endif
 
 typedef struct opl_t
 {
@@ -10,6 +24,18 @@ typedef struct opl_t
 
         int16_t buffer[MAXSOUNDBUFLEN * 2];
         int     pos;
+#ifdef UAE
+        int is_opl3;
+
+        opl_fifo_entry_t fifo[OPL_FIFO_SIZE];
+        volatile int fifo_read_idx, fifo_write_idx;
+
+        volatile int fifo_thread_state;
+        thread_t *fifo_thread;
+        event_t *wake_fifo_thread;
+        event_t *fifo_not_full_event;
+        event_t *fifo_sync_event;
+#endif
 } opl_t;
 
 uint8_t opl2_read(uint16_t a, void *priv);
@@ -26,6 +52,9 @@ void opl3_poll(opl_t *opl, int16_t *bufl, int16_t *bufr);
 
 void opl2_init(opl_t *opl);
 void opl3_init(opl_t *opl, int opl_emu);
+#ifdef UAE
+void opl_close(opl_t *opl);
+#endif
 
 void opl2_update2(opl_t *opl);
 void opl3_update2(opl_t *opl);
@@ -1101,6 +1101,9 @@ void sb_close(void *p)
 {
         sb_t *sb = (sb_t *)p;
         sb_dsp_close(&sb->dsp);
+#ifdef UAE
+        opl_close(&sb->opl);
+#endif
         #ifdef SB_DSP_RECORD_DEBUG
             if (soundfsb != 0)
             {
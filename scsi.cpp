@@ -84,8 +84,8 @@
 
 extern int log_scsiemu;
 
-static const uae_s16 outcmd[] = { 0x04, 0x0a, 0x0c, 0x11, 0x2a, 0xaa, 0x15, 0x55, 0x0f, -1 };
-static const uae_s16 incmd[] = { 0x01, 0x03, 0x08, 0x0e, 0x12, 0x1a, 0x5a, 0x25, 0x28, 0x34, 0x37, 0x42, 0x43, 0xa8, 0x51, 0x52, 0xb9, 0xbd, 0xd8, 0xd9, 0xbe, -1 };
+static const uae_s16 outcmd[] = { 0x04, 0x0a, 0x0c, 0x11, 0x2a, 0xaa, 0x8a, 0x15, 0x55, 0x0f, -1 };
+static const uae_s16 incmd[] = { 0x01, 0x03, 0x08, 0x0e, 0x12, 0x1a, 0x5a, 0x25, 0x28, 0x34, 0x37, 0x42, 0x43, 0xa8, 0x88, 0x51, 0x52, 0xb9, 0xbd, 0xd8, 0xd9, 0xbe, -1 };
 static const uae_s16 nonecmd[] = { 0x00, 0x05, 0x06, 0x07, 0x09, 0x0b, 0x10, 0x16, 0x17, 0x19, 0x1b, 0x1d, 0x1e, 0x2b, 0x35, 0x45, 0x47, 0x48, 0x49, 0x4b, 0x4e, 0xa5, 0xa9, 0xba, 0xbc, 0xe0, 0xe3, 0xe4, -1 };
 static const uae_s16 safescsi[] = { 0x00, 0x01, 0x03, 0x08, 0x0e, 0x0f, 0x12, 0x1a, 0x1b, 0x25, 0x28, 0x35, 0x5a, -1 };
 static const uae_s16 scsicmdsizes[] = { 6, 10, 10, 12, 16, 12, 10, 6 };
@@ -195,6 +195,12 @@ bool scsi_emulate_analyze (struct scsi_data *sd)
 		data_len2 = ((sd->cmd[6] << 24) | (sd->cmd[7] << 16) | (sd->cmd[8] << 8) | (sd->cmd[9] << 0)) * sd->blocksize;
 		scsi_grow_buffer(sd, data_len2);
 	break;
+	case 0x88: // READ(16)
+		if (sd->device_type == UAEDEV_CD)
+			goto nocmd;
+		data_len2 = ((sd->cmd[10] << 24) | (sd->cmd[11] << 16) | (sd->cmd[12] << 8) | (sd->cmd[13] << 0)) * sd->blocksize;
+		scsi_grow_buffer(sd, data_len2);
+	break;
 	case 0x0f: // WRITE SECTOR BUFFER
 		data_len = sd->blocksize;
 		scsi_grow_buffer(sd, data_len);
@@ -217,6 +223,12 @@ bool scsi_emulate_analyze (struct scsi_data *sd)
 		data_len = ((sd->cmd[6] << 24) | (sd->cmd[7] << 16) | (sd->cmd[8] << 8) | (sd->cmd[9] << 0)) * sd->blocksize;
 		scsi_grow_buffer(sd, data_len);
 	break;
+	case 0x8a: // WRITE(16)
+		if (sd->device_type == UAEDEV_CD)
+			goto nocmd;
+		data_len = ((sd->cmd[10] << 24) | (sd->cmd[11] << 16) | (sd->cmd[12] << 8) | (sd->cmd[13] << 0)) * sd->blocksize;
+		scsi_grow_buffer(sd, data_len);
+	break;
 	case 0xbe: // READ CD
 	case 0xb9: // READ CD MSF
 	case 0xd8: // READ CD-DA
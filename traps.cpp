@@ -25,6 +25,11 @@
 #include "uae.h"
 #include "debug.h"
 
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define TRAP_SWAP_SSE2 1
+#endif
+
 /*
 * Traps are the mechanism via which 68k code can call emulator code
 * (and for that emulator code in turn to call 68k code). They are
@@ -1165,6 +1170,72 @@ uae_u8 trap_get_byte(TrapContext *ctx, uaecptr addr)
 	}
 }
 
+/* Number of bytes from addr (max cnt) that get_real_address() can reach
+ * as one contiguous host block, 0 if addr itself is not directly addressable.
+ * Runs are extended one 64k bank slot at a time while the bank continues. */
+static int trap_direct_run(uaecptr addr, int cnt)
+{
+	if (!real_address_allowed())
+		return 0;
+	if (valid_address(addr, cnt))
+		return cnt;
+	addrbank *ab = &get_mem_bank(addr);
+	int len = 0;
+	while (len < cnt) {
+		int run = 65536 - ((addr + len) & 65535);
+		if (run > cnt - len)
+			run = cnt - len;
+		if (&get_mem_bank(addr + len) != ab || !valid_address(addr, len + run))
+			break;
+		len += run;
+	}
+	return len;
+}
+
+/* bytes left in the 64k bank slot containing addr, max cnt */
+static int trap_slot_run(uaecptr addr, int cnt)
+{
+	int run = 65536 - (addr & 65535);
+	return run > cnt ? cnt : run;
+}
+
+/* host <-> big endian copies, src and dst may be unaligned */
+static void trap_swap_longs(uae_u8 *dst, const uae_u8 *src, int cnt)
+{
+	int i = 0;
+#ifdef TRAP_SWAP_SSE2
+	for (; i + 4 <= cnt; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), v);
+	}
+#endif
+	for (; i < cnt; i++) {
+		uae_u32 v;
+		memcpy(&v, src + i * 4, 4);
+		v = do_byteswap_32(v);
+		memcpy(dst + i * 4, &v, 4);
+	}
+}
+static void trap_swap_words(uae_u8 *dst, const uae_u8 *src, int cnt)
+{
+	int i = 0;
+#ifdef TRAP_SWAP_SSE2
+	for (; i + 8 <= cnt; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*)(dst + i * 2), v);
+	}
+#endif
+	for (; i < cnt; i++) {
+		uae_u16 v;
+		memcpy(&v, src + i * 2, 2);
+		v = do_byteswap_16(v);
+		memcpy(dst + i * 2, &v, 2);
+	}
+}
+
 void trap_put_bytes(TrapContext *ctx, const void *haddrp, uaecptr addr, int cnt)
 {
 	if (cnt <= 0)
@@ -1180,13 +1251,19 @@ void trap_put_bytes(TrapContext *ctx, const void *haddrp, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		if (real_address_allowed() && valid_address(addr, cnt)) {
-			memcpy(get_real_address(addr), haddr, cnt);
-		} else {
-			for (int i = 0; i < cnt; i++) {
-				put_byte(addr, *haddr++);
-				addr++;
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt);
+			if (len > 0) {
+				memcpy(get_real_address(addr), haddr, len);
+			} else {
+				len = trap_slot_run(addr, cnt);
+				for (int i = 0; i < len; i++) {
+					put_byte(addr + i, haddr[i]);
+				}
 			}
+			haddr += len;
+			addr += len;
+			cnt -= len;
 		}
 	}
 }
@@ -1205,13 +1282,19 @@ void trap_get_bytes(TrapContext *ctx, void *haddrp, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		if (real_address_allowed() && valid_address(addr, cnt)) {
-			memcpy(haddr, get_real_address(addr), cnt);
-		} else {
-			for (int i = 0; i < cnt; i++) {
-				*haddr++ = get_byte(addr);
-				addr++;
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt);
+			if (len > 0) {
+				memcpy(haddr, get_real_address(addr), len);
+			} else {
+				len = trap_slot_run(addr, cnt);
+				for (int i = 0; i < len; i++) {
+					haddr[i] = get_byte(addr + i);
+				}
 			}
+			haddr += len;
+			addr += len;
+			cnt -= len;
 		}
 	}
 }
@@ -1230,10 +1313,20 @@ void trap_put_longs(TrapContext *ctx, uae_u32 *haddr, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		uae_u32 *p = (uae_u32*)haddr;
-		for (int i = 0; i < cnt; i++) {
-			put_long(addr, *p++);
-			addr += 4;
+		while (cnt > 0) {
+			/* whole elements only, one that straddles a bank goes the slow way */
+			int len = trap_direct_run(addr, cnt * sizeof(uae_u32)) / sizeof(uae_u32);
+			if (len > 0) {
+				trap_swap_longs(get_real_address(addr), (uae_u8*)haddr, len);
+			} else {
+				len = (trap_slot_run(addr, cnt * sizeof(uae_u32)) + sizeof(uae_u32) - 1) / sizeof(uae_u32);
+				for (int i = 0; i < len; i++) {
+					put_long(addr + i * sizeof(uae_u32), haddr[i]);
+				}
+			}
+			haddr += len;
+			addr += len * sizeof(uae_u32);
+			cnt -= len;
 		}
 	}
 }
@@ -1252,10 +1345,19 @@ void trap_get_longs(TrapContext *ctx, uae_u32 *haddr, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		uae_u32 *p = (uae_u32*)haddr;
-		for (int i = 0; i < cnt; i++) {
-			*p++ = get_long(addr);
-			addr += 4;
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt * sizeof(uae_u32)) / sizeof(uae_u32);
+			if (len > 0) {
+				trap_swap_longs((uae_u8*)haddr, get_real_address(addr), len);
+			} else {
+				len = (trap_slot_run(addr, cnt * sizeof(uae_u32)) + sizeof(uae_u32) - 1) / sizeof(uae_u32);
+				for (int i = 0; i < len; i++) {
+					haddr[i] = get_long(addr + i * sizeof(uae_u32));
+				}
+			}
+			haddr += len;
+			addr += len * sizeof(uae_u32);
+			cnt -= len;
 		}
 	}
 }
@@ -1274,10 +1376,20 @@ void trap_put_words(TrapContext *ctx, uae_u16 *haddr, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		uae_u16 *p = (uae_u16*)haddr;
-		for (int i = 0; i < cnt; i++) {
-			put_word(addr, *p++);
-			addr += sizeof(uae_u16);
+		while (cnt > 0) {
+			/* whole elements only, one that straddles a bank goes the slow way */
+			int len = trap_direct_run(addr, cnt * sizeof(uae_u16)) / sizeof(uae_u16);
+			if (len > 0) {
+				trap_swap_words(get_real_address(addr), (uae_u8*)haddr, len);
+			} else {
+				len = (trap_slot_run(addr, cnt * sizeof(uae_u16)) + sizeof(uae_u16) - 1) / sizeof(uae_u16);
+				for (int i = 0; i < len; i++) {
+					put_word(addr + i * sizeof(uae_u16), haddr[i]);
+				}
+			}
+			haddr += len;
+			addr += len * sizeof(uae_u16);
+			cnt -= len;
 		}
 	}
 }
@@ -1296,10 +1408,19 @@ void trap_get_words(TrapContext *ctx, uae_u16 *haddr, uaecptr addr, int cnt)
 			cnt -= max;
 		}
 	} else {
-		uae_u16 *p = (uae_u16*)haddr;
-		for (int i = 0; i < cnt; i++) {
-			*p++ = get_word(addr);
-			addr += sizeof(uae_u16);
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt * sizeof(uae_u16)) / sizeof(uae_u16);
+			if (len > 0) {
+				trap_swap_words((uae_u8*)haddr, get_real_address(addr), len);
+			} else {
+				len = (trap_slot_run(addr, cnt * sizeof(uae_u16)) + sizeof(uae_u16) - 1) / sizeof(uae_u16);
+				for (int i = 0; i < len; i++) {
+					haddr[i] = get_word(addr + i * sizeof(uae_u16));
+				}
+			}
+			haddr += len;
+			addr += len * sizeof(uae_u16);
+			cnt -= len;
 		}
 	}
 }
@@ -1346,11 +1467,26 @@ int trap_get_string(TrapContext *ctx, void *haddrp, uaecptr addr, int maxlen)
 		}
 	} else {
 		for (;;) {
-			uae_u8 v = get_byte(addr);
-			*haddr++ = v;
-			addr++;
-			if (!v)
-				break;
+			int run = trap_direct_run(addr, maxlen > 0 ? maxlen : 1);
+			if (run > 0) {
+				uae_u8 *p = get_real_address(addr);
+				uae_u8 *end = (uae_u8*)memchr(p, 0, run);
+				if (end) {
+					memcpy(haddr, p, end - p + 1);
+					break;
+				}
+				memcpy(haddr, p, run);
+				haddr += run;
+				addr += run;
+				maxlen -= run;
+			} else {
+				uae_u8 v = get_byte(addr);
+				*haddr++ = v;
+				addr++;
+				maxlen--;
+				if (!v)
+					break;
+			}
 		}
 		len++;
 	}
@@ -1394,9 +1530,21 @@ void trap_set_longs(TrapContext *ctx, uaecptr addr, uae_u32 v, int cnt)
 	if (trap_is_indirect_null(ctx)) {
 		call_hardware_trap_back(ctx, TRAPCMD_SET_LONGS, addr, v, cnt, 0);
 	} else {
-		for (int i = 0; i < cnt; i++) {
-			put_long(addr, v);
-			addr += 4;
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt * 4) / 4;
+			if (len > 0) {
+				uae_u32 *p = (uae_u32*)get_real_address(addr);
+				for (int i = 0; i < len; i++) {
+					do_put_mem_long(p + i, v);
+				}
+			} else {
+				len = (trap_slot_run(addr, cnt * 4) + 3) / 4;
+				for (int i = 0; i < len; i++) {
+					put_long(addr + i * 4, v);
+				}
+			}
+			addr += len * 4;
+			cnt -= len;
 		}
 	}
 }
@@ -1420,9 +1568,18 @@ void trap_set_bytes(TrapContext *ctx, uaecptr addr, uae_u8 v, int cnt)
 	if (trap_is_indirect_null(ctx)) {
 		call_hardware_trap_back(ctx, TRAPCMD_SET_BYTES, addr, v, cnt, 0);
 	} else {
-		for (int i = 0; i < cnt; i++) {
-			put_byte(addr, v);
-			addr += 1;
+		while (cnt > 0) {
+			int len = trap_direct_run(addr, cnt);
+			if (len > 0) {
+				memset(get_real_address(addr), v, len);
+			} else {
+				len = trap_slot_run(addr, cnt);
+				for (int i = 0; i < len; i++) {
+					put_byte(addr + i, v);
+				}
+			}
+			addr += len;
+			cnt -= len;
 		}
 	}
 }
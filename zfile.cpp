@@ -24,6 +24,8 @@
 #include "diskutil.h"
 #include "fdi2raw.h"
 #include "uae/io.h"
+#include "uae.h"
+#include "threaddep/thread.h"
 // OS X does not have off64_t, fopen64, fseeko64 or ftello64, the functions are already 64bit
 #ifdef __MACH__
 #  define off64_t off_t
@@ -171,11 +173,139 @@ static struct zcache *zcache_put (const TCHAR *name, struct zdiskimage *data)
 	return zc;
 }
 
+/*
+* Streaming decompression: data is allocated for the full size up front
+* and datasize grows as the decoder runs. Reads past datasize decode on
+* demand, a background thread decodes the rest meanwhile. Everything
+* already decoded stays in memory, so seeking back never restarts the
+* decoder.
+*/
+
+#define ZSTREAM_CHUNK 262144
+#define ZSTREAM_MIN_SIZE (4 * 1024 * 1024)
+
+typedef int (*ZSTREAMDECODE)(struct zstream*, uae_u8*, int);
+typedef void (*ZSTREAMEND)(struct zstream*);
+
+struct zstream
+{
+	struct zfile *src;
+	ZSTREAMDECODE decode; // returns number of bytes written, 0 or less = error
+	ZSTREAMEND end;
+	void *state;
+	uae_sem_t lock;
+	volatile int thread_state; // 1 = running, -1 = stop requested, 0 = stopped
+	bool error;
+};
+
+// decode one more chunk, returns false when done or failed
+static bool zstream_step (struct zfile *z)
+{
+	struct zstream *zs = z->stream;
+	bool more = false;
+
+	uae_sem_wait (&zs->lock);
+	if (z->datasize < z->size && !zs->error) {
+		int len = (int)(z->size - z->datasize);
+		if (len > ZSTREAM_CHUNK)
+			len = ZSTREAM_CHUNK;
+		int got = zs->decode (zs, z->data + z->datasize, len);
+		if (got <= 0) {
+			write_log (_T("%s: decompression failed at %lld\n"), z->name, z->datasize);
+			zs->error = true;
+		} else {
+			z->datasize += got;
+			more = z->datasize < z->size;
+		}
+	}
+	uae_sem_post (&zs->lock);
+	return more;
+}
+
+static bool zstream_fill (struct zfile *z, uae_s64 upto)
+{
+	struct zstream *zs = z->stream;
+	bool ok;
+
+	if (upto > z->size)
+		upto = z->size;
+	for (;;) {
+		uae_sem_wait (&zs->lock);
+		ok = z->datasize >= upto;
+		uae_sem_post (&zs->lock);
+		if (ok || !zstream_step (z))
+			break;
+	}
+	uae_sem_wait (&zs->lock);
+	ok = z->datasize >= upto;
+	uae_sem_post (&zs->lock);
+	return ok;
+}
+
+static void zstream_thread (void *v)
+{
+	struct zfile *z = (struct zfile*)v;
+	struct zstream *zs = z->stream;
+	while (zs->thread_state > 0 && zstream_step (z));
+	zs->thread_state = 0;
+}
+
+static void zstream_free (struct zfile *z)
+{
+	struct zstream *zs = z->stream;
+	if (!zs)
+		return;
+	if (zs->thread_state > 0) {
+		zs->thread_state = -1;
+		while (zs->thread_state)
+			sleep_millis (1);
+	}
+	if (zs->end)
+		zs->end (zs);
+	zfile_fclose (zs->src);
+	uae_sem_destroy (&zs->lock);
+	xfree (zs);
+	z->stream = NULL;
+}
+
+// decode everything and drop the decoder
+static void zstream_finish (struct zfile *z)
+{
+	if (!z->stream)
+		return;
+	zstream_fill (z, z->size);
+	zstream_free (z);
+}
+
+static struct zfile *zstream_open (struct zfile *src, const TCHAR *name, uae_s64 size, ZSTREAMDECODE decode, ZSTREAMEND end, void *state)
+{
+	struct zfile *z;
+	struct zstream *zs;
+
+	z = zfile_fopen_empty (src, name, size);
+	if (!z)
+		return NULL;
+	zs = xcalloc (struct zstream, 1);
+	zs->src = src;
+	zs->decode = decode;
+	zs->end = end;
+	zs->state = state;
+	uae_sem_init (&zs->lock, 0, 1);
+	z->stream = zs;
+	z->datasize = 0;
+	zs->thread_state = 1;
+	if (!uae_start_thread (_T("zstream"), zstream_thread, z, NULL))
+		zs->thread_state = 0;
+	write_log (_T("%s: streaming decompression, %lld bytes\n"), name, size);
+	return z;
+}
+
 static void checkarchiveparent (struct zfile *z)
 {
 	// unpack completely if opened in PEEK mode
 	if (z->archiveparent)
 		archive_unpackzfile (z);
+	zstream_finish (z);
 }
 
 static struct zfile *zfile_create (struct zfile *prev, const TCHAR *originalname)
@@ -199,10 +329,28 @@ static struct zfile *zfile_create (struct zfile *prev, const TCHAR *originalname
 	return z;
 }
 
+static bool zfile_mapfile (struct zfile *z)
+{
+	uae_s64 size;
+	void *handle;
+	uae_u8 *data = my_mapfile (z->name, &size, &handle);
+	if (!data)
+		return false;
+	z->data = data;
+	z->maphandle = handle;
+	z->size = z->datasize = size;
+	return true;
+}
+
 static void zfile_free (struct zfile *f)
 {
+	zstream_free (f);
 	if (f->f)
 		fclose (f->f);
+	if (f->maphandle) {
+		my_unmapfile (f->data, f->maphandle);
+		f->data = NULL;
+	}
 	if (f->deleteafterclose) {
 		_wunlink (f->name);
 		write_log (_T("deleted temporary file '%s'\n"), f->name);
@@ -564,6 +712,40 @@ end:
 	return z;
 }
 
+struct gzstream
+{
+	z_stream zs;
+	uae_u8 in[8192];
+};
+
+static int gzstream_decode (struct zstream *zs, uae_u8 *out, int len)
+{
+	struct gzstream *gz = (struct gzstream*)zs->state;
+	gz->zs.next_out = out;
+	gz->zs.avail_out = len;
+	while (gz->zs.avail_out > 0) {
+		if (gz->zs.avail_in == 0) {
+			gz->zs.next_in = gz->in;
+			gz->zs.avail_in = (uInt)zfile_fread (gz->in, 1, sizeof (gz->in), zs->src);
+			if (gz->zs.avail_in == 0)
+				break;
+		}
+		int ret = inflate (&gz->zs, 0);
+		if (ret == Z_STREAM_END)
+			break;
+		if (ret != Z_OK)
+			return -1;
+	}
+	return len - gz->zs.avail_out;
+}
+
+static void gzstream_end (struct zstream *zs)
+{
+	struct gzstream *gz = (struct gzstream*)zs->state;
+	inflateEnd (&gz->zs);
+	xfree (gz);
+}
+
 static struct zfile *zfile_gunzip (struct zfile *z, int *retcode)
 {
 	uae_u8 header[2 + 1 + 1 + 4 + 1 + 1];
@@ -626,6 +808,16 @@ static struct zfile *zfile_gunzip (struct zfile *z, int *retcode)
 	if (size < 8 || size > 256 * 1024 * 1024) /* safety check */
 		return NULL;
 	zfile_fseek (z, offset, SEEK_SET);
+	if (size >= ZSTREAM_MIN_SIZE) {
+		struct gzstream *gz = xcalloc (struct gzstream, 1);
+		if (inflateInit2_ (&gz->zs, -MAX_WBITS, ZLIB_VERSION, sizeof (z_stream)) == Z_OK) {
+			z2 = zstream_open (z, name, size, gzstream_decode, gzstream_end, gz);
+			if (z2)
+				return z2;
+			inflateEnd (&gz->zs);
+		}
+		xfree (gz);
+	}
 	z2 = zfile_fopen_empty (z, name, size);
 	if (!z2)
 		return NULL;
@@ -1173,6 +1365,97 @@ static void SzFree(void *p, void *address)
 }
 #define XZ_OUT_SIZE 10000
 #define XZ_IN_SIZE 10000
+static int xz_getvli (const uae_u8 *p, int *pos, int len, uae_u64 *v)
+{
+	*v = 0;
+	for (int i = 0; i < 9 && *pos < len; i++) {
+		uae_u8 b = p[(*pos)++];
+		*v |= (uae_u64)(b & 0x7f) << (i * 7);
+		if (!(b & 0x80))
+			return 1;
+	}
+	return 0;
+}
+
+// uncompressed size from the index of a single stream .xz file, 0 if unknown
+static uae_s64 xz_getsize (struct zfile *z)
+{
+	uae_u8 footer[12];
+	uae_u8 *index;
+	uae_s64 size = 0;
+	uae_u64 records, unpadded, uncompressed;
+	int pos, indexsize;
+
+	uae_s64 filesize = zfile_size (z);
+	if (filesize < 12 + 12)
+		return 0;
+	zfile_fseek (z, filesize - 12, SEEK_SET);
+	if (zfile_fread (footer, sizeof footer, 1, z) != 1 || footer[10] != 'Y' || footer[11] != 'Z')
+		return 0;
+	indexsize = ((footer[4] | (footer[5] << 8) | (footer[6] << 16) | (footer[7] << 24)) + 1) * 4;
+	if (indexsize > 1024 * 1024 || indexsize > filesize - 24)
+		return 0;
+	index = xmalloc (uae_u8, indexsize);
+	zfile_fseek (z, filesize - 12 - indexsize, SEEK_SET);
+	if (zfile_fread (index, indexsize, 1, z) == 1 && index[0] == 0) {
+		pos = 1;
+		if (xz_getvli (index, &pos, indexsize, &records)) {
+			while (records-- > 0) {
+				if (!xz_getvli (index, &pos, indexsize, &unpadded) || !xz_getvli (index, &pos, indexsize, &uncompressed)) {
+					size = 0;
+					break;
+				}
+				size += uncompressed;
+			}
+		}
+	}
+	xfree (index);
+	zfile_fseek (z, 0, SEEK_SET);
+	return size;
+}
+
+struct xzstream
+{
+	CXzUnpacker cx;
+	uae_u8 in[XZ_IN_SIZE];
+	int inpos, inlen;
+	bool finished;
+};
+
+static int xzstream_decode (struct zstream *zs, uae_u8 *out, int len)
+{
+	struct xzstream *xs = (struct xzstream*)zs->state;
+	ECoderStatus status;
+	int done = 0;
+
+	while (done < len && !xs->finished) {
+		if (xs->inpos >= xs->inlen) {
+			xs->inpos = 0;
+			xs->inlen = (int)zfile_fread (xs->in, 1, XZ_IN_SIZE, zs->src);
+			if (xs->inlen <= 0)
+				break;
+		}
+		SizeT srclen = xs->inlen - xs->inpos;
+		SizeT outlen = len - done;
+		if (XzUnpacker_Code (&xs->cx, out + done, &outlen, xs->in + xs->inpos, &srclen, LZMA_FINISH_ANY, &status) != SZ_OK)
+			return -1;
+		xs->inpos += (int)srclen;
+		done += (int)outlen;
+		if (status == CODER_STATUS_FINISHED_WITH_MARK)
+			xs->finished = true;
+		else if (status != CODER_STATUS_NEEDS_MORE_INPUT && status != CODER_STATUS_NOT_FINISHED)
+			return -1;
+	}
+	return done;
+}
+
+static void xzstream_end (struct zstream *zs)
+{
+	struct xzstream *xs = (struct xzstream*)zs->state;
+	XzUnpacker_Free (&xs->cx);
+	xfree (xs);
+}
+
 static struct zfile *xz (struct zfile *z, int *retcode)
 {
 	static bool iscrc;
@@ -1190,6 +1473,20 @@ static struct zfile *xz (struct zfile *z, int *retcode)
 	if (!iscrc)
 		CrcGenerateTable ();
 	iscrc = true;
+
+	uae_s64 size = xz_getsize (z);
+	if (size >= ZSTREAM_MIN_SIZE && size <= INT_MAX) {
+		// allocator functions only, safe to share
+		static ISzAlloc streamalloc = { SzAlloc, SzFree };
+		struct xzstream *xs = xcalloc (struct xzstream, 1);
+		XzUnpacker_Construct (&xs->cx, &streamalloc);
+		zo = zstream_open (z, z->name, size, xzstream_decode, xzstream_end, xs);
+		if (zo)
+			return zo;
+		XzUnpacker_Free (&xs->cx);
+		xfree (xs);
+	}
+
 //	if (XzUnpacker_Create (&cx, &allocImp) != SZ_OK)
 //		return NULL;
 	XzUnpacker_Construct (&cx, &allocImp);
@@ -1728,6 +2025,8 @@ static struct zfile *zfile_fopen_2 (const TCHAR *name, const TCHAR *mode, int ma
 		l->mode = my_strdup (mode);
 		l->name = my_strdup (name);
 		l->zfdmask = mask;
+		if ((mask & ZFD_MMAP) && !_tcscmp (mode, _T("rb")) && zfile_mapfile (l))
+			return l;
 		if (!_tcsicmp (mode, _T("r"))) {
 			f = my_opentext (l->name);
 			l->textmode = 1;
@@ -1985,12 +2284,19 @@ struct zfile *zfile_dup (struct zfile *zf)
 	struct zfile *nzf;
 	if (!zf)
 		return NULL;
-	if (zf->archiveparent)
-		checkarchiveparent (zf);
+	checkarchiveparent (zf);
 	if (zf->userdata)
 		return NULL;
 	if (!zf->data && zf->dataseek) {
 		nzf = zfile_create (zf, NULL);
+	} else if (zf->maphandle) {
+		nzf = zfile_create (zf, NULL);
+		nzf->name = my_strdup (zf->name);
+		if (!zfile_mapfile (nzf)) {
+			zfile_fclose (nzf);
+			return NULL;
+		}
+		xfree (nzf->name);
 	} else if (zf->data) {
 		if (zf->size > INT_MAX) {
 			return NULL;
@@ -2047,7 +2353,7 @@ int zfile_exists (const TCHAR *name)
 
 int zfile_iscompressed (struct zfile *z)
 {
-	return z->data ? 1 : 0;
+	return z->data && !z->maphandle ? 1 : 0;
 }
 
 struct zfile *zfile_fopen_empty (struct zfile *prev, const TCHAR *name, uae_u64 size)
@@ -2139,12 +2445,33 @@ struct zfile *zfile_fopen_data (const TCHAR *name, uae_u64 size, const uae_u8 *d
 /* dump file use only */
 uae_u8 *zfile_get_data_pointer(struct zfile *z, size_t *len)
 {
+	zstream_finish (z);
 	if (!z->data)
 		return NULL;
 	*len = (size_t)z->size;
 	return z->data;
 }
 
+/* direct access to memory or memory mapped file contents, NULL if not available */
+const uae_u8 *zfile_get_data_range(struct zfile *z, uae_s64 offset, uae_s64 len)
+{
+	if (z->zfileread || offset < 0 || len < 0)
+		return NULL;
+	if (z->data) {
+		if (z->stream && !zstream_fill (z, offset + len))
+			return NULL;
+		if (offset + len > z->datasize)
+			return NULL;
+		return z->data + z->offset + offset;
+	}
+	if (z->parent && z->useparent) {
+		if (offset + len > z->size)
+			return NULL;
+		return zfile_get_data_range(z->parent, z->offset + offset, len);
+	}
+	return NULL;
+}
+
 uae_u8 *zfile_load_data (const TCHAR *name, const uae_u8 *data,int datalen, int *outlen)
 {
 	struct zfile *zf, *f;
@@ -2153,6 +2480,7 @@ uae_u8 *zfile_load_data (const TCHAR *name, const uae_u8 *data,int datalen, int
 	
 	zf = zfile_fopen_data (name, datalen, data);
 	f = zfile_gunzip (zf);
+	zstream_finish (f);
 	size = (int)f->datasize;
 	zfile_fseek (f, 0, SEEK_SET);
 	out = xmalloc (uae_u8, size);
@@ -2182,6 +2510,9 @@ uae_u8 *zfile_load_file(const TCHAR *name, int *outlen)
 
 int zfile_truncate (struct zfile *z, uae_s64 size)
 {
+	if (z->maphandle)
+		return 0;
+	zstream_finish (z);
 	if (z->data) {
 		if (z->size > size) {
 			z->size = size;
@@ -2282,20 +2613,23 @@ size_t zfile_fread(void *b, size_t l1, size_t l2, struct zfile *z)
 	if (z->zfileread)
 		return (size_t)z->zfileread(b, l1, l2, z);
 	if (z->data) {
-		if (z->datasize < z->size && z->seek + l1 * l2 > z->datasize) {
+		uae_s64 size = z->size;
+		if (z->stream) {
+			// decoder failed: return whatever was decoded before the error
+			if (!zstream_fill (z, z->seek + l1 * l2))
+				size = z->datasize;
+		} else if (z->datasize < z->size && z->seek + l1 * l2 > z->datasize) {
 			if (z->archiveparent) {
 				archive_unpackzfile (z);
 				return zfile_fread (b, l1, l2, z);
 			}
 			return 0;
 		}
-		if (z->seek + l1 * l2 > z->size) {
-			if (l1)
-				l2 = (size_t)((z->size - z->seek) / l1);
+		if (z->seek + l1 * l2 > size) {
+			if (l1 && z->seek < size)
+				l2 = (size_t)((size - z->seek) / l1);
 			else
 				l2 = 0;
-			if (l2 < 0)
-				l2 = 0;
 		}
 		memcpy (b, z->data + z->offset + z->seek, l1 * l2);
 		z->seek += l1 * l2;
@@ -2331,6 +2665,9 @@ size_t zfile_fwrite(const void *b, size_t l1, size_t l2, struct zfile *z)
 		return (size_t)z->zfilewrite(b, l1, l2, z);
 	if (z->parent && z->useparent)
 		return 0;
+	if (z->maphandle)
+		return 0;
+	zstream_finish (z);
 	if (z->data) {
 		uae_s64 off = z->seek + l1 * l2;
 		if (z->allocsize == 0) {
@@ -2575,6 +2912,7 @@ uae_u32 zfile_crc32(struct zfile *f)
 
 	if (!f)
 		return 0;
+	zstream_finish (f);
 	if (f->data)
 		return get_crc32(f->data, (uae_u32)f->size);
 	pos = zfile_ftell32(f);
@@ -21,6 +21,8 @@
 #include "crc32.h"
 #include "zarchive.h"
 #include "disk.h"
+#include "fsdb.h"
+#include "uae.h"
 
 #include <zlib.h>
 
@@ -2160,9 +2162,219 @@ struct zfile *archive_unpackzfile (struct zfile *zf)
 	return NULL;
 }
 
+/*
+* Persistent cache of unpacked archive entries. Entries are stored in
+* <data path>ArchiveCache as plain files named by the SHA-1 of archive
+* path, size, modification time and entry name, and are evicted oldest
+* first when the cache grows beyond archive_cache_size megabytes.
+*/
+
+#define ARCHIVE_CACHE_DIR _T("ArchiveCache")
+#define ARCHIVE_CACHE_MIN_SIZE 65536
+
+static bool archive_cache_path (TCHAR *path, int size)
+{
+	if (currprefs.archive_cache_size <= 0)
+		return false;
+	fetch_datapath (path, size);
+	fixtrailing (path);
+	_tcscat (path, ARCHIVE_CACHE_DIR);
+	if (!my_existsdir (path) && my_mkdir (path))
+		return false;
+	_tcscat (path, FSDB_DIR_SEPARATOR_S);
+	return true;
+}
+
+static bool archive_cache_name (struct znode *zn, unsigned int id, TCHAR *out, int size)
+{
+	struct zvolume *zv = zn->volume;
+	struct mystat st;
+	TCHAR key[MAX_DPATH * 2];
+	uae_u8 sha1[20];
+	char *keya;
+
+	if (zn->size < ARCHIVE_CACHE_MIN_SIZE || zn->size > INT_MAX)
+		return false;
+	// only top level archives that exist as real files can be keyed
+	if (!zv || !zv->archive || zv->archive->parent || !zv->archive->name || !my_stat (zv->archive->name, &st))
+		return false;
+	if (!archive_cache_path (out, size))
+		return false;
+	_stprintf (key, _T("%s|%lld|%lld|%u|%s|%lld"), zv->archive->name, st.size, st.mtime.tv_sec, id, zn->fullname, zn->size);
+	keya = uutf8 (key);
+	get_sha1 (keya, uaestrlen (keya), sha1);
+	xfree (keya);
+	TCHAR *p = out + _tcslen (out);
+	for (int i = 0; i < 20; i++)
+		_stprintf (p + i * 2, _T("%02x"), sha1[i]);
+	return true;
+}
+
+// same name, parent (originalname, zfdmask) as archive_access_*() would give it
+static struct zfile *archive_cache_empty (struct znode *zn, unsigned int id)
+{
+	switch (id)
+	{
+	case ArchiveFormatRAR:
+		return zfile_fopen_empty (zn->volume->archive, zn->fullname, zn->size);
+	case ArchiveFormatLHA:
+	case ArchiveFormatLZX:
+		return zfile_fopen_empty (zn->volume->archive, zn->name, zn->size);
+	}
+	return zfile_fopen_empty (NULL, zn->fullname, zn->size);
+}
+
+static struct zfile *archive_cache_get (struct znode *zn, unsigned int id)
+{
+	TCHAR path[MAX_DPATH];
+	struct zfile *f, *zf;
+
+	if (!archive_cache_name (zn, id, path, sizeof path / sizeof (TCHAR)))
+		return NULL;
+	if (!my_existsfile (path))
+		return NULL;
+	f = zfile_fopen (path, _T("rb"), ZFD_MMAP);
+	if (!f)
+		return NULL;
+	if (zfile_size (f) != zn->size) {
+		zfile_fclose (f);
+		my_unlink (path, true);
+		return NULL;
+	}
+	// return a normal in-memory file, callers expect unpacked entries to be writable copies
+	zf = archive_cache_empty (zn, id);
+	if (zf) {
+		zfile_fseek (f, 0, SEEK_SET);
+		if (zfile_fread (zf->data, (size_t)zn->size, 1, f) != 1) {
+			zfile_fclose (zf);
+			zf = NULL;
+		}
+	}
+	zfile_fclose (f);
+	if (zf) {
+		// keep recently used entries at the end of the eviction order
+		my_utime (path, NULL);
+		write_log (_T("ARCHIVECACHE: '%s' from cache\n"), zn->fullname);
+	}
+	return zf;
+}
+
+struct archive_cache_entry
+{
+	TCHAR *path;
+	uae_s64 size, mtime;
+};
+
+static int archive_cache_cmp (const void *a, const void *b)
+{
+	const struct archive_cache_entry *e1 = (const struct archive_cache_entry*)a;
+	const struct archive_cache_entry *e2 = (const struct archive_cache_entry*)b;
+	return e1->mtime < e2->mtime ? -1 : (e1->mtime > e2->mtime ? 1 : 0);
+}
+
+static void archive_cache_evict (const TCHAR *dir, uae_s64 keep)
+{
+	struct my_opendir_s *od;
+	TCHAR fname[MAX_DPATH], path[MAX_DPATH];
+	struct archive_cache_entry *list = NULL;
+	int cnt = 0, max = 0;
+	uae_s64 total = 0;
+	struct mystat st;
+
+	od = my_opendir (dir);
+	if (!od)
+		return;
+	while (my_readdir (od, fname)) {
+		if (fname[0] == '.')
+			continue;
+		_stprintf (path, _T("%s%s"), dir, fname);
+		if (!my_stat (path, &st))
+			continue;
+		if (cnt >= max) {
+			struct archive_cache_entry *nlist = xrealloc (struct archive_cache_entry, list, max ? max * 2 : 64);
+			if (!nlist)
+				break;
+			list = nlist;
+			max = max ? max * 2 : 64;
+		}
+		list[cnt].path = my_strdup (path);
+		list[cnt].size = st.size;
+		list[cnt].mtime = st.mtime.tv_sec;
+		total += st.size;
+		cnt++;
+	}
+	my_closedir (od);
+	// oldest first
+	if (total > keep)
+		qsort (list, cnt, sizeof (struct archive_cache_entry), archive_cache_cmp);
+	for (int i = 0; i < cnt; i++) {
+		if (total > keep) {
+			write_log (_T("ARCHIVECACHE: evicting '%s' (%lld bytes)\n"), list[i].path, list[i].size);
+			if (!my_unlink (list[i].path, true))
+				total -= list[i].size;
+		}
+		xfree (list[i].path);
+	}
+	xfree (list);
+}
+
+static void archive_cache_put (struct znode *zn, unsigned int id, struct zfile *zf)
+{
+	TCHAR path[MAX_DPATH], tmp[MAX_DPATH], dir[MAX_DPATH];
+	struct zfile *f;
+	uae_s64 maxsize = (uae_s64)currprefs.archive_cache_size * 1024 * 1024;
+
+	if (!zf->data || zf->archiveparent || zf->size != zn->size || zf->size > maxsize)
+		return;
+	if (!archive_cache_name (zn, id, path, sizeof path / sizeof (TCHAR)))
+		return;
+	if (my_existsfile (path))
+		return;
+	archive_cache_path (dir, sizeof dir / sizeof (TCHAR));
+	archive_cache_evict (dir, maxsize - zf->size);
+	// write under a temporary name so that an interrupted write is never used
+	_stprintf (tmp, _T("%s.tmp"), path);
+	f = zfile_fopen (tmp, _T("wb"), 0);
+	if (!f)
+		return;
+	bool ok = zfile_fwrite (zf->data, (size_t)zf->size, 1, f) == 1;
+	zfile_fclose (f);
+	if (!ok || my_rename (tmp, path)) {
+		my_unlink (tmp, true);
+		return;
+	}
+	write_log (_T("ARCHIVECACHE: '%s' stored (%lld bytes)\n"), zn->fullname, zf->size);
+}
+
+static bool archive_cache_format (unsigned int id, int flags)
+{
+	switch (id)
+	{
+	case ArchiveFormat7Zip:
+	case ArchiveFormatRAR:
+	case ArchiveFormatLHA:
+	case ArchiveFormatLZX:
+		return true;
+	case ArchiveFormatZIP:
+		// delayed open unpacks on first access, nothing to gain
+		return (flags & FILE_DELAYEDOPEN) == 0;
+	}
+	return false;
+}
+
 struct zfile *archive_getzfile (struct znode *zn, unsigned int id, int flags)
 {
 	struct zfile *zf = NULL;
+	bool cache = archive_cache_format (id, flags) && currprefs.archive_cache_size > 0;
+
+	if (cache) {
+		zf = archive_cache_get (zn, id);
+		if (zf) {
+			zf->archiveid = id;
+			zfile_fseek (zf, 0, SEEK_SET);
+			return zf;
+		}
+	}
 
 	switch (id)
 	{
@@ -2211,6 +2423,8 @@ struct zfile *archive_getzfile (struct znode *zn, unsigned int id, int flags)
 		break;
 	}
 	if (zf) {
+		if (cache)
+			archive_cache_put (zn, id, zf);
 		zf->archiveid = id;
 		zfile_fseek (zf, 0, SEEK_SET);
 	}